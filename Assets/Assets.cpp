@@ -33,86 +33,116 @@ static const char* BASE_PATH_SPEECH     = "Data\\Audio\\Speech\\English\\";
 static const char* BASE_PATH_SCRIPTS    = "Data\\Scripts\\";
 static const char* BASE_PATH_XML        = "Data\\XML\\";
 
-ptr<File> LoadXML(const std::string& filename)
+// A file name to search for an asset, with its alternative extensions
+struct AssetPath
 {
-    static const char* const extensions[] = {"xml", NULL};
-    return LoadFile(BASE_PATH_XML + filename, extensions);
-}
-
-ptr<File> LoadTexture(const std::string& filename)
-{
-    static const char* const extensions[] = {"tga", "dds", NULL};
-    return LoadFile(BASE_PATH_TEXTURES + filename, extensions);
-}
+    string             filename;
+    const char* const* extensions;
+};
 
-ptr<File> LoadAnimation(const std::string& filename)
+// Gets the file names that are searched for an asset, in order.
+// Returns the number of file names.
+static size_t GetAssetPaths(AssetType type, const string& filename, AssetPath paths[2])
 {
-    static const char* const extensions[] = {"ala", NULL};
-    return LoadFile(BASE_PATH_ANIMATIONS + filename, extensions);
-}
-
-ptr<File> LoadModelParticle(const std::string& filename)
-{
-    static const char* const extensions[] = {"alo", NULL};
-    return LoadFile(BASE_PATH_MODELS + filename, extensions);
-}
-
-ptr<File> LoadShader(const std::string& filename)
-{
-    static const char* const extensions[] = {"fx", "fxo"};
-    return LoadFile(BASE_PATH_SHADERS + filename, extensions);
-}
-
-ptr<File> LoadMap(const std::string& filename)
-{
-    static const char* const extensions[] = {"ted", NULL};
-    return LoadFile(BASE_PATH_MAPS + filename, extensions);
-}
-
-ptr<File> LoadSFX(const std::string& filename)
-{
-    static const char* const extensions[] = {"wav", NULL};
-
-    int i = filename.find('\\');
-    int j = filename.find('/');
-
-    // Check if the path already contains a path. If so we should not use the pre defined base path
-    if (i >= 0 || j >= 0)
+    static const char* const EXTENSIONS_XML[]       = {"xml", NULL};
+    static const char* const EXTENSIONS_TEXTURE[]   = {"tga", "dds", NULL};
+    static const char* const EXTENSIONS_ANIMATION[] = {"ala", NULL};
+    static const char* const EXTENSIONS_MODEL[]     = {"alo", NULL};
+    static const char* const EXTENSIONS_SHADER[]    = {"fx", "fxo", NULL};
+    static const char* const EXTENSIONS_MAP[]       = {"ted", NULL};
+    static const char* const EXTENSIONS_WAV[]       = {"wav", NULL};
+    static const char* const EXTENSIONS_MP3[]       = {"mp3", NULL};
+    static const char* const EXTENSIONS_SCRIPT[]    = {"lua", NULL};
+    static const char* const EXTENSIONS_CINEMATIC[] = {"tec", NULL};
+
+    paths[0].filename = filename;
+    switch (type)
     {
-        return LoadFile(filename, extensions);
+    case ASSET_FILE:            paths[0].extensions = NULL; break;
+    case ASSET_XML:             paths[0].filename = BASE_PATH_XML        + filename; paths[0].extensions = EXTENSIONS_XML;       break;
+    case ASSET_TEXTURE:         paths[0].filename = BASE_PATH_TEXTURES   + filename; paths[0].extensions = EXTENSIONS_TEXTURE;   break;
+    case ASSET_ANIMATION:       paths[0].filename = BASE_PATH_ANIMATIONS + filename; paths[0].extensions = EXTENSIONS_ANIMATION; break;
+    case ASSET_MODEL_PARTICLE:  paths[0].filename = BASE_PATH_MODELS     + filename; paths[0].extensions = EXTENSIONS_MODEL;     break;
+    case ASSET_SHADER:          paths[0].filename = BASE_PATH_SHADERS    + filename; paths[0].extensions = EXTENSIONS_SHADER;    break;
+    case ASSET_MAP:             paths[0].filename = BASE_PATH_MAPS       + filename; paths[0].extensions = EXTENSIONS_MAP;       break;
+    case ASSET_MUSIC:           paths[0].filename = BASE_PATH_MUSIC      + filename; paths[0].extensions = EXTENSIONS_MP3;       break;
+    case ASSET_SCRIPT:          paths[0].filename = BASE_PATH_SCRIPTS    + filename; paths[0].extensions = EXTENSIONS_SCRIPT;    break;
+    case ASSET_CINEMATIC:       paths[0].filename = BASE_PATH_CINEMATICS + filename; paths[0].extensions = EXTENSIONS_CINEMATIC; break;
+
+    case ASSET_SFX:
+        // Check if the path already contains a path. If so we should not use the pre defined base path
+        if (filename.find_first_of("\\/") == string::npos) {
+            paths[0].filename = BASE_PATH_SFX + filename;
+        }
+        paths[0].extensions = EXTENSIONS_WAV;
+        break;
+
+    case ASSET_SPEECH:
+        // Speech can also be a sound effect
+        paths[0].filename   = BASE_PATH_SPEECH + filename;
+        paths[0].extensions = EXTENSIONS_MP3;
+        paths[1].filename   = BASE_PATH_SFX + filename;
+        paths[1].extensions = EXTENSIONS_WAV;
+        return 2;
     }
-
-    return LoadFile(BASE_PATH_SFX + filename, extensions);
-}
-
-ptr<File> LoadMusic(const std::string& filename)
-{
-    static const char* const extensions[] = {"mp3", NULL};
-    return LoadFile(BASE_PATH_MUSIC + filename, extensions);
+    return 1;
 }
 
-ptr<File> LoadSpeech(const std::string& filename)
+ptr<File> Load(AssetType type, const std::string& filename)
 {
+    AssetPath paths[2];
     ptr<File> f;
-    static const char* const extensions[] = {"mp3", NULL};
-    if ((f = LoadFile(BASE_PATH_SPEECH + filename, extensions)) == NULL)
+    for (size_t i = 0, n = GetAssetPaths(type, filename, paths); f == NULL && i < n; i++)
     {
-        static const char* const extensions[] = {"wav", NULL};
-        f = LoadFile(BASE_PATH_SFX + filename, extensions);
+        f = LoadFile(paths[i].filename, paths[i].extensions);
     }
     return f;
 }
 
-ptr<File> LoadScript(const std::string& filename)
+bool Exists(AssetType type, const std::string& filename)
 {
-    static const char* const extensions[] = {"lua", NULL};
-    return LoadFile(BASE_PATH_SCRIPTS + filename, extensions);
+    AssetPath paths[2];
+    for (size_t i = 0, n = GetAssetPaths(type, filename, paths); i < n; i++)
+    {
+        if (FileExists(paths[i].filename, paths[i].extensions))
+        {
+            return true;
+        }
+    }
+    return false;
 }
 
-ptr<File> LoadCinematic(const std::string& filename)
+std::vector<bool> Exists(AssetType type, const std::vector<std::string>& filenames)
 {
-    static const char* const extensions[] = {"tec", NULL};
-    return LoadFile(BASE_PATH_CINEMATICS + filename, extensions);
+    vector<FileQuery> queries;
+    for (size_t i = 0; i < filenames.size(); i++)
+    {
+        AssetPath paths[2];
+        for (size_t j = 0, n = GetAssetPaths(type, filenames[i], paths); j < n; j++)
+        {
+            FileQuery query;
+            query.filename   = paths[j].filename;
+            query.extensions = paths[j].extensions;
+            query.index      = i;
+            queries.push_back(query);
+        }
+    }
+
+    vector<bool> found(filenames.size(), false);
+    FilesExist(queries, found);
+    return found;
 }
 
-}
\ No newline at end of file
+ptr<File> LoadXML(const std::string& filename)           { return Load(ASSET_XML,            filename); }
+ptr<File> LoadTexture(const std::string& filename)       { return Load(ASSET_TEXTURE,        filename); }
+ptr<File> LoadAnimation(const std::string& filename)     { return Load(ASSET_ANIMATION,      filename); }
+ptr<File> LoadModelParticle(const std::string& filename) { return Load(ASSET_MODEL_PARTICLE, filename); }
+ptr<File> LoadShader(const std::string& filename)        { return Load(ASSET_SHADER,         filename); }
+ptr<File> LoadMap(const std::string& filename)           { return Load(ASSET_MAP,            filename); }
+ptr<File> LoadSFX(const std::string& filename)           { return Load(ASSET_SFX,            filename); }
+ptr<File> LoadMusic(const std::string& filename)         { return Load(ASSET_MUSIC,          filename); }
+ptr<File> LoadSpeech(const std::string& filename)        { return Load(ASSET_SPEECH,         filename); }
+ptr<File> LoadScript(const std::string& filename)        { return Load(ASSET_SCRIPT,         filename); }
+ptr<File> LoadCinematic(const std::string& filename)     { return Load(ASSET_CINEMATIC,      filename); }
+
+}
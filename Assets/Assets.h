@@ -54,6 +54,38 @@ namespace Assets
     ptr<File> LoadSpeech(const std::string& filename);
     ptr<File> LoadScript(const std::string& filename);
     ptr<File> LoadCinematic(const std::string& filename);
+
+    // The asset types, as loaded by the functions above
+    enum AssetType
+    {
+        ASSET_FILE,
+        ASSET_TEXTURE,
+        ASSET_ANIMATION,
+        ASSET_MODEL_PARTICLE,
+        ASSET_MAP,
+        ASSET_SHADER,
+        ASSET_XML,
+        ASSET_SFX,
+        ASSET_MUSIC,
+        ASSET_SPEECH,
+        ASSET_SCRIPT,
+        ASSET_CINEMATIC,
+    };
+
+    // Loads an asset of the specified type, like the function for the type
+    ptr<File> Load(AssetType type, const std::string& filename);
+
+    //
+    // Returns true if the load function of the type would find the asset.
+    // The MegaFile index and listings of the directories in the search paths
+    // are used, so no files are opened. The directories are listed on first
+    // use and not again, so this should only be used from the main thread.
+    //
+    bool Exists(AssetType type, const std::string& filename);
+
+    // Checks a batch of assets of the type in one pass over the directory
+    // listings and the MegaFile index. Returns whether each one exists.
+    std::vector<bool> Exists(AssetType type, const std::vector<std::string>& filenames);
 }
 
 #endif
@@ -173,4 +173,13 @@ ChunkReader::~ChunkReader()
     m_file.Release();
 }
 
+ChunkType PeekChunkType(File& file)
+{
+	CHUNKHDR hdr;
+	file.SetPosition(0);
+	const size_t read = file.Read((void*)&hdr, sizeof(CHUNKHDR));
+	file.SetPosition(0);
+	return (read == sizeof(CHUNKHDR)) ? (ChunkType)letohl(hdr.type) : -1;
+}
+
 }
\ No newline at end of file
@@ -53,6 +53,10 @@ public:
     ~ChunkReader();
 };
 
+// Returns the type of the first chunk in the file, or -1 if the
+// file is too small to have one. The file is left at its start.
+ChunkType PeekChunkType(File& file);
+
 //
 // TemplateReader is a class to allow for the reading
 // of values from ChunkReaders by templates.
@@ -3,7 +3,11 @@
 #include "General/Utils.h"
 #include "General/ExactTypes.h"
 #include "General/Exceptions.h"
+#include "General/Stats.h"
 #include <algorithm>
+#include <set>
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
 using namespace std;
 
 namespace Assets
@@ -16,12 +20,17 @@ namespace Assets
 FileIndex                 g_FileIndex;
 std::vector<std::wstring> g_SearchPaths;
 
+// Uppercased names of the files in directories of the search paths,
+// by uppercased directory path. See PhysicalFileExists().
+static map<wstring, set<string> > g_Directories;
+
 static ptr<File> LoadPhysicalFile(const wstring& basepath, const string& filename)
 {
     try
     {
         wstring path = basepath + Utils::ConvertAnsiStringToWideString(filename);
         ptr<File> f = File::Open(path, filename);
+        Stats::AddFileProbe(true, f != NULL);
 #ifdef DEBUG_ASSETS
         if (f != NULL)
         {
@@ -32,6 +41,7 @@ static ptr<File> LoadPhysicalFile(const wstring& basepath, const string& filenam
     }
     catch (FileNotFoundException&)
     {
+        Stats::AddFileProbe(true, false);
     }
     return NULL;
 }
@@ -50,13 +60,70 @@ static ptr<File> LoadVirtualFile(const std::string& filename_)
 #ifdef DEBUG_ASSETS
                 printf("Loading %s\n", filename_.c_str());
 #endif
+                Stats::AddFileProbe(false, true);
                 return new File(*p->file, q->second.start, q->second.size, filename_);
             }
         }
     }
+    Stats::AddFileProbe(false, false);
     return NULL;
 }
 
+// Returns the uppercased names of the files in the directory in a search path.
+// The directory is listed once, so checking many files in it is cheap.
+static const set<string>& GetDirectory(const wstring& basepath, const string& directory)
+{
+    const wstring path = Utils::Uppercase(basepath + Utils::ConvertAnsiStringToWideString(directory));
+
+    map<wstring, set<string> >::iterator p = g_Directories.find(path);
+    if (p == g_Directories.end())
+    {
+        p = g_Directories.insert(make_pair(path, set<string>())).first;
+
+        WIN32_FIND_DATA wfd;
+        HANDLE hFind = FindFirstFile((path + L"*").c_str(), &wfd);
+        if (hFind != INVALID_HANDLE_VALUE)
+        {
+            do
+            {
+                if (~wfd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+                {
+                    p->second.insert(Utils::Uppercase(Utils::ConvertWideStringToAnsiString(wfd.cFileName)));
+                }
+            } while (FindNextFile(hFind, &wfd));
+            FindClose(hFind);
+        }
+    }
+    return p->second;
+}
+
+// Like LoadPhysicalFile, but looks the file up in a listing of its directory
+static bool PhysicalFileExists(const wstring& basepath, const string& filename)
+{
+    const string::size_type sep = filename.find_last_of('\\');
+    const set<string>& files = GetDirectory(basepath, filename.substr(0, sep + 1));
+
+    const bool found = (files.find(Utils::Uppercase(filename.substr(sep + 1))) != files.end());
+    Stats::AddFileProbe(true, found);
+    return found;
+}
+
+// Like LoadVirtualFile, without creating the file
+static bool VirtualFileExists(const std::string& filename_)
+{
+    const string filename = Utils::Uppercase(filename_);
+    for (FileIndex::const_iterator p = g_FileIndex.begin(); p != g_FileIndex.end(); ++p)
+    {
+        if (filename.compare(0, p->base.length(), p->base) == 0 && p->files.find(filename.substr(p->base.length())) != p->files.end())
+        {
+            Stats::AddFileProbe(false, true);
+            return true;
+        }
+    }
+    Stats::AddFileProbe(false, false);
+    return false;
+}
+
 static inline void ReplaceAll2(std::string& str, const std::string& from, const std::string& to)
 {
     size_t start_pos = 0;
@@ -66,7 +133,9 @@ static inline void ReplaceAll2(std::string& str, const std::string& from, const
     }
 }
 
-ptr<File> LoadFile(string filename, const char* const * Extensions)
+// Gets the names to try for a file, in order: with its own
+// extension, then with each of the alternative extensions.
+static void GetCandidates(string filename, const char* const * Extensions, vector<string>& names)
 {
     // Strip the extension of the filename
     string ext;
@@ -80,51 +149,153 @@ ptr<File> LoadFile(string filename, const char* const * Extensions)
         filename.erase(dot);
     }
 
-    // Not in the cache, try to load the file
+    names.push_back(filename + ext);
+    if (Extensions != NULL)
+    {
+        for (size_t i = 0; Extensions[i] != NULL; i++)
+        {
+            names.push_back(filename + "." + Extensions[i]);
+        }
+    }
+}
+
+ptr<File> LoadFile(string filename, const char* const * Extensions)
+{
+    vector<string> names;
+    GetCandidates(filename, Extensions, names);
+
     ptr<File> file;
     try
     {
         // Search for the physical file in the specified search paths.
         for (vector<wstring>::const_iterator p = g_SearchPaths.begin(); file == NULL && p != g_SearchPaths.end(); ++p)
         {
-            // First try with the given extension
-            if (((file = LoadPhysicalFile(*p, filename + ext)) == NULL) && Extensions != NULL)
+            for (vector<string>::const_iterator n = names.begin(); file == NULL && n != names.end(); ++n)
             {
-                // Not found, try with the alternative extensions, if any
-                for (size_t i = 0; Extensions[i] != NULL; i++)
-                {
-                    if ((file = LoadPhysicalFile(*p, filename + "." + Extensions[i])) != NULL)
-                    {
-                        // Found it
-                        break;
-                    }
-                }
+                file = LoadPhysicalFile(*p, *n);
             }
         }
 
-        if (file == NULL)
+        // Not found, try file index
+        for (vector<string>::const_iterator n = names.begin(); file == NULL && n != names.end(); ++n)
         {
-            // Not found, try file index
-            // First try with the given extension
-            if (((file = LoadVirtualFile(filename + ext)) == NULL) && Extensions != NULL)
+            file = LoadVirtualFile(*n);
+        }
+    }
+    catch (IOException&)
+    {
+    }
+
+    return file;
+}
+
+bool FileExists(string filename, const char* const * Extensions)
+{
+    vector<string> names;
+    GetCandidates(filename, Extensions, names);
+
+    for (vector<wstring>::const_iterator p = g_SearchPaths.begin(); p != g_SearchPaths.end(); ++p)
+    {
+        for (vector<string>::const_iterator n = names.begin(); n != names.end(); ++n)
+        {
+            if (PhysicalFileExists(*p, *n)) {
+                return true;
+            }
+        }
+    }
+
+    for (vector<string>::const_iterator n = names.begin(); n != names.end(); ++n)
+    {
+        if (VirtualFileExists(*n)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// A name to look for in FilesExist(), split in directory and file name
+struct FileName
+{
+    string directory;
+    string name;
+    size_t index;
+
+    bool operator < (const FileName& rhs) const {
+        return (directory != rhs.directory) ? directory < rhs.directory : name < rhs.name;
+    }
+};
+
+void FilesExist(const vector<FileQuery>& files, vector<bool>& found)
+{
+    // Get all names to look for, uppercased and sorted by directory and name
+    vector<FileName> names;
+    for (vector<FileQuery>::const_iterator f = files.begin(); f != files.end(); ++f)
+    {
+        vector<string> candidates;
+        GetCandidates(f->filename, f->extensions, candidates);
+        for (vector<string>::const_iterator c = candidates.begin(); c != candidates.end(); ++c)
+        {
+            const string            name = Utils::Uppercase(*c);
+            const string::size_type sep  = name.find_last_of('\\');
+            FileName fn;
+            fn.directory = name.substr(0, sep + 1);
+            fn.name      = name.substr(sep + 1);
+            fn.index     = f->index;
+            names.push_back(fn);
+        }
+    }
+    sort(names.begin(), names.end());
+
+    // Merge the names of each directory with its listing in each search path
+    for (vector<wstring>::const_iterator p = g_SearchPaths.begin(); p != g_SearchPaths.end(); ++p)
+    {
+        for (vector<FileName>::const_iterator n = names.begin(); n != names.end();)
+        {
+            const set<string>& listing = GetDirectory(*p, n->directory);
+            set<string>::const_iterator l = listing.begin();
+            const string directory = n->directory;
+            for (; n != names.end() && n->directory == directory; ++n)
             {
-                // Not found, try with the alternative extensions
-                for (size_t i = 0; Extensions[i] != NULL; i++)
-                {
-                    if ((file = LoadVirtualFile(filename + "." + Extensions[i])) != NULL)
-                    {
-                        // Found it
-                        break;
-                    }
+                while (l != listing.end() && *l < n->name) {
+                    ++l;
+                }
+                if (l != listing.end() && *l == n->name) {
+                    found[n->index] = true;
                 }
             }
         }
     }
-    catch (IOException&)
+
+    // Merge the full names with each MegaFile's sorted index. Sorting by
+    // directory and name doesn't sort the full names, so sort those again.
+    vector<pair<string, size_t> > fullnames;
+    for (vector<FileName>::const_iterator n = names.begin(); n != names.end(); ++n)
     {
+        if (!found[n->index]) {
+            fullnames.push_back(make_pair(n->directory + n->name, n->index));
+        }
     }
+    sort(fullnames.begin(), fullnames.end());
 
-    return file;
+    for (FileIndex::const_iterator p = g_FileIndex.begin(); p != g_FileIndex.end(); ++p)
+    {
+        vector<pair<string, size_t> >::const_iterator n = lower_bound(fullnames.begin(), fullnames.end(), make_pair(p->base, (size_t)0));
+        if (n == fullnames.end() || n->first.compare(0, p->base.length(), p->base) != 0) {
+            continue;
+        }
+
+        map<string, FileInfo>::const_iterator f = p->files.lower_bound(n->first.substr(p->base.length()));
+        for (; n != fullnames.end() && n->first.compare(0, p->base.length(), p->base) == 0; ++n)
+        {
+            const string name = n->first.substr(p->base.length());
+            while (f != p->files.end() && f->first < name) {
+                ++f;
+            }
+            if (f != p->files.end() && f->first == name) {
+                found[n->second] = true;
+            }
+        }
+    }
 }
 
 ptr<File> LoadFile(const std::string& filename)
@@ -267,5 +438,6 @@ void Uninitialize()
 {
     g_FileIndex.clear();
     g_SearchPaths.clear();
+    g_Directories.clear();
 }
 }
\ No newline at end of file
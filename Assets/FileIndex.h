@@ -29,6 +29,21 @@ namespace Assets
     extern std::vector<std::wstring> g_SearchPaths;
 
     ptr<File> LoadFile(std::string filename, const char* const * Extensions);
+    bool      FileExists(std::string filename, const char* const * Extensions);
+
+    // A file for FilesExist(): a name with its alternative extensions
+    struct FileQuery
+    {
+        std::string        filename;
+        const char* const* extensions;
+        size_t             index;       // Index in the result of the file
+    };
+
+    // Checks a batch of files, like FileExists() for each of them. Instead of
+    // looking up each file, the sorted names are merged with the sorted
+    // directory listings and MegaFile indices. found[index] is set to true
+    // for the files that exist; it is not cleared for the others.
+    void FilesExist(const std::vector<FileQuery>& files, std::vector<bool>& found);
 }
 
 #endif
\ No newline at end of file
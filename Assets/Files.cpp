@@ -1,5 +1,6 @@
 #include "Assets/Files.h"
 #include "General/Exceptions.h"
+#include "General/Stats.h"
 #include <cassert>
 using namespace std;
 
@@ -13,36 +14,34 @@ is created from the filesystem.
 */
 struct File::Info
 {
-    HANDLE       m_hFile;       // Handle of the file
-    size_t       m_size;        // Size of the file
-    size_t       m_cursor;      // Current cursor info the file
-    unsigned int m_references;  // #References to this instance
+    HANDLE        m_hFile;       // Handle of the file
+    size_t        m_size;        // Size of the file
+    volatile LONG m_references;  // #References to this instance
 
-    // Set the file pointer
-    void Seek(size_t offset)
-    {
-        if (m_cursor != offset)
-        {
-            m_cursor = SetFilePointer(m_hFile, (LONG)offset, NULL, FILE_BEGIN);
-        }
-    }
-
-    size_t Read(void* buffer, size_t size)
+    // Reads from the specified offset. Does not use the file
+    // pointer, so files can be read from several threads.
+    size_t Read(size_t offset, void* buffer, size_t size)
     {
         // Size should have already been sanitized
-        assert(m_cursor + size <= m_size);
+        assert(offset + size <= m_size);
+
+        OVERLAPPED overlapped = {0};
+        overlapped.Offset = (DWORD)offset;
 
         DWORD read;
-        if (!ReadFile(m_hFile, buffer, (DWORD)size, &read, NULL))
+        if (!ReadFile(m_hFile, buffer, (DWORD)size, &read, &overlapped))
         {
-            throw ReadException();
+            if (GetLastError() != ERROR_HANDLE_EOF)
+            {
+                throw ReadException();
+            }
+            read = 0;
         }
-        m_cursor += read;
         return read;
     }
 
     Info(HANDLE hFile)
-        : m_hFile(hFile), m_cursor(0), m_references(1)
+        : m_hFile(hFile), m_references(1)
     {
 	    m_size = GetFileSize(m_hFile, NULL);
     }
@@ -63,12 +62,75 @@ size_t File::Read(void* buffer, size_t size)
     // Sanitize input
     size = min(m_size - m_cursor, size);
 
-    m_info->Seek(m_base + m_cursor);
-    size_t read = m_info->Read(buffer, size);
+    size_t read = m_info->Read(m_base + m_cursor, buffer, size);
     m_cursor += read;
+    Stats::AddBytesRead(read);
     return read;
 }
 
+unsigned long long File::GetFingerprint() const
+{
+    BY_HANDLE_FILE_INFORMATION info;
+    if (!GetFileInformationByHandle(m_info->m_hFile, &info))
+    {
+        throw ReadException();
+    }
+
+    // 64-bit FNV-1a over the fields
+    const unsigned long long fields[] = {
+        info.dwVolumeSerialNumber,
+        ((unsigned long long)info.nFileIndexHigh << 32) | info.nFileIndexLow,
+        ((unsigned long long)info.nFileSizeHigh  << 32) | info.nFileSizeLow,
+        ((unsigned long long)info.ftLastWriteTime.dwHighDateTime << 32) | info.ftLastWriteTime.dwLowDateTime,
+        m_base,
+        m_size,
+    };
+    unsigned long long hash = 14695981039346656037ULL;
+    const unsigned char* data = (const unsigned char*)fields;
+    for (size_t i = 0; i < sizeof fields; i++)
+    {
+        hash = (hash ^ data[i]) * 1099511628211ULL;
+    }
+    return (hash != 0) ? hash : 1;
+}
+
+FileView* File::Map() const
+{
+    if (m_size == 0)
+    {
+        // Empty views can't be mapped
+        return new FileView(NULL, NULL, 0);
+    }
+
+    // Views start on the allocation granularity; subfiles of a MegaFile rarely do
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    const size_t start = m_base - m_base % info.dwAllocationGranularity;
+
+    HANDLE hMapping = CreateFileMapping(m_info->m_hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (hMapping == NULL)
+    {
+        throw ReadException();
+    }
+
+    // The view keeps the mapping alive
+    void* view = MapViewOfFile(hMapping, FILE_MAP_READ, 0, (DWORD)start, m_base - start + m_size);
+    CloseHandle(hMapping);
+    if (view == NULL)
+    {
+        throw ReadException();
+    }
+    return new FileView(view, (const char*)view + (m_base - start), m_size);
+}
+
+FileView::~FileView()
+{
+    if (m_view != NULL)
+    {
+        UnmapViewOfFile(m_view);
+    }
+}
+
 File* File::Open(const wstring& path, const string& name)
 {
     HANDLE hFile = CreateFile(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
@@ -109,12 +171,12 @@ File::File(const File& f, unsigned long offset, size_t size, const string& name)
     m_base += f.m_base;
 
     // Add a reference
-    m_info->m_references++;
+    InterlockedIncrement(&m_info->m_references);
 }
 
 File::~File()
 {
-    if (--m_info->m_references == 0)
+    if (InterlockedDecrement(&m_info->m_references) == 0)
     {
         delete m_info;
     }
@@ -4,6 +4,8 @@
 #include "General/Objects.h"
 #include <string>
 
+class FileView;
+
 class File : public Object
 {
     struct Info;
@@ -27,10 +29,35 @@ public:
 
     const std::string&  GetName() const { return m_name; }
 
+    // Identifies the file and its version: the file on disk, its size and last
+    // write time, and the range of a subfile in it. Never zero.
+    unsigned long long GetFingerprint() const;
+
+    // Maps the contents of the file into memory, without reading them.
+    // The view stays valid after the file is closed.
+    FileView* Map() const;
+
     static File* Open(const std::wstring& path, const std::string& name);
 
     File(const File& f, unsigned long base, size_t size, const std::string& name);
     ~File();
 };
 
+// A read-only view of a file's contents in memory; see File::Map()
+class FileView : public Object
+{
+    friend class File;
+
+    void*       m_view;     // Start of the mapped pages
+    const char* m_data;
+    size_t      m_size;
+
+    FileView(void* view, const char* data, size_t size) : m_view(view), m_data(data), m_size(size) {}
+public:
+    const char* GetData() const { return m_data; }
+    size_t      GetSize() const { return m_size; }
+
+    ~FileView();
+};
+
 #endif
\ No newline at end of file
@@ -1,7 +1,7 @@
 #include "MTD.h"
 #include "General/ExactTypes.h"
-#include "General/Utils.h"
 #include "General/Exceptions.h"
+#include <algorithm>
 using namespace std;
 
 #pragma pack(1)
@@ -15,8 +15,7 @@ struct FileInfo
 
 bool MegaTextureDirectory::exists(const string& filename) const
 {
-    string name = Utils::Uppercase(filename);
-    return m_files.find(name) != m_files.end();
+    return m_files.exists(filename);
 }
 
 MegaTextureDirectory::MegaTextureDirectory(const ptr<File> f)
@@ -32,6 +31,6 @@ MegaTextureDirectory::MegaTextureDirectory(const ptr<File> f)
         if (f->Read(&fi, sizeof fi) != sizeof fi) {
             throw ReadException();
         }
-        m_files.insert(fi.name);
+        m_files.insert(string(fi.name, find(fi.name, fi.name + sizeof fi.name, '\0')));
     }
 }
@@ -2,11 +2,11 @@
 #define ASSETS_MTD_H
 
 #include "Assets/Files.h"
-#include <set>
+#include "General/NameSet.h"
 
 class MegaTextureDirectory
 {
-    std::set<std::string> m_files;
+    NameSet m_files;
 
 public:
     bool exists(const std::string& filename) const;
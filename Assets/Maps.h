@@ -7,8 +7,6 @@
 
 namespace Assets {
 
-class ChunkReader;
-
 enum MapType
 {
     MAP_LAND = 0,
@@ -16,12 +14,24 @@ enum MapType
     NUM_MAP_TYPES
 };
 
+// Sections of a map to load. The properties are always loaded.
+// Chunks of sections that aren't loaded are skipped without reading them.
+enum MapSection
+{
+    MAP_PROPERTIES   = 0,
+    MAP_ENVIRONMENTS = 1,
+    MAP_TERRAIN      = 2,   // Water, layers and tracks
+    MAP_OBJECTS      = 4,
+    MAP_ALL          = MAP_ENVIRONMENTS | MAP_TERRAIN | MAP_OBJECTS
+};
+
+// Combines sections, so a mask is still a MapSection, e.g. MAP_ENVIRONMENTS | MAP_OBJECTS
+inline MapSection operator|(MapSection a, MapSection b) { return (MapSection)((unsigned int)a | (unsigned int)b); }
+
 class Map
 {
-    class Loader_EaW;
-    class Loader_FoC;
-    friend class Loader_EaW;
-    friend class Loader_FoC;
+    class Loader;
+    friend class Loader;
 public:
     struct Track
     {
@@ -69,10 +79,6 @@ private:
 	std::vector<Environment> m_environments;
     std::vector<Track>       m_tracks;
     std::vector<Object>      m_objects;
- 
-    void ReadMap_EaW(ChunkReader& reader, bool properties_only);
-    void ReadMap_FoC(ChunkReader& reader, bool properties_only);
-    void ReadMap(ChunkReader& reader, GameID game, bool properties_only);
 public:
     const Properties&               GetProperties()   const { return m_properties; }
     const Water&                    GetWater()        const { return m_water; }
@@ -86,8 +92,9 @@ public:
     // The file pointer is restored after determining the game.
     static GameID DetectGameID(File& file);
 
-    Map(File& file, bool properties_only = false);              // Loads a map, auto-detects game type
-    Map(File& file, GameID game, bool properties_only = false); // Loads a map, of the specified game type
+    // Loads the specified sections of a map of the specified game type.
+    // The game type is detected if it's GID_NONE.
+    Map(File& file, MapSection sections = MAP_ALL, GameID game = GID_NONE);
 };
 
 }
@@ -2,6 +2,8 @@
 #include "General/Utils.h"
 #include "General/ExactTypes.h"
 #include "General/Exceptions.h"
+#include <algorithm>
+#include <cstring>
 using namespace std;
 
 #pragma pack(1)
@@ -13,56 +15,131 @@ struct Entry
 };
 #pragma pack()
 
-struct StringInfo
+// Reads an entry from the table in the mapped file
+static Entry GetEntry(const char* entries, size_t index)
 {
-    unsigned long nValChars;
-    unsigned long nKeyChars;
-    unsigned long nValOffset;
-    unsigned long nKeyOffset;
-};
+    Entry entry;
+    memcpy(&entry, entries + index * sizeof(Entry), sizeof entry);
+    entry.crc       = letohl(entry.crc);
+    entry.nValChars = letohl(entry.nValChars);
+    entry.nKeyChars = letohl(entry.nKeyChars);
+    return entry;
+}
 
-bool StringList::exists(const std::string& name) const
+// Orders entry indices by CRC
+struct CompareCRC
 {
-    return m_strings.find(name) != m_strings.end();
-}
+    const char* entries;
 
-StringList::StringList(ptr<File> f)
+    bool operator()(size_t a, size_t b) const {
+        return GetEntry(entries, a).crc < GetEntry(entries, b).crc;
+    }
+
+    CompareCRC(const char* entries) : entries(entries) {}
+};
+
+void StringList::Index() const
 {
+    if (m_file == NULL) {
+        return;
+    }
+    m_view = m_file->Map();
+
+    const char*  data = m_view->GetData();
+    const size_t size = m_view->GetSize();
+
     uint32_t leCount;
-    if (f->Read(&leCount, sizeof leCount) != sizeof leCount)
+    if (size < sizeof leCount)
     {
         throw ReadException();
     }
+    memcpy(&leCount, data, sizeof leCount);
+    const size_t count = letohl(leCount);
+    if (count > (size - sizeof leCount) / sizeof(Entry))
+    {
+        throw ReadException();
+    }
+    m_entries = data + sizeof leCount;
 
-    unsigned long nValOffset = 0;
-    unsigned long nKeyOffset = 0;
-
-    vector<StringInfo> strings(letohl(leCount));
-    for (size_t i = 0; i < strings.size(); i++)
+    // Names are stored back to back, after the values
+    size_t nValChars = 0;
+    bool   sorted    = true;
+    m_offsets.resize(count + 1);
+    m_offsets[0] = 0;
+    for (size_t i = 0; i < count; i++)
     {
-        Entry entry;
-        if (f->Read(&entry, sizeof entry) != sizeof entry)
+        const Entry entry = GetEntry(m_entries, i);
+        if (entry.nKeyChars > size - m_offsets[i] || entry.nValChars > size - nValChars)
         {
             throw ReadException();
         }
-        strings[i].nKeyOffset = nKeyOffset;
-        strings[i].nValOffset = nValOffset;
-        nKeyOffset += (strings[i].nKeyChars = letohl(entry.nKeyChars));
-        nValOffset += (strings[i].nValChars = letohl(entry.nValChars));
+        m_offsets[i + 1] = m_offsets[i] + entry.nKeyChars;
+        nValChars       += entry.nValChars;
+        sorted           = sorted && (i == 0 || GetEntry(m_entries, i - 1).crc <= entry.crc);
     }
 
-    vector<wchar_t> values(nValOffset);
-    vector<char>    keys(nKeyOffset);
-    if (f->Read(&values[0], values.size() * sizeof(wchar_t)) != values.size() * sizeof(wchar_t) ||
-        f->Read(&keys[0], keys.size() * sizeof(char)) != keys.size() * sizeof(char))
+    const size_t nValBytes = nValChars * sizeof(uint16_t);  // UTF-16
+    const size_t start     = sizeof leCount + count * sizeof(Entry);
+    if (nValBytes > size - start || m_offsets[count] > size - start - nValBytes)
     {
         throw ReadException();
     }
+    m_keys  = m_entries + count * sizeof(Entry) + nValBytes;
 
-    for (size_t i = 0; i < strings.size(); i++)
+    if (!sorted)
     {
-        m_strings.insert(make_pair(
-             string(&keys  [strings[i].nKeyOffset], strings[i].nKeyChars),
-            wstring(&values[strings[i].nValOffset], strings[i].nValChars)));
+        // The game writes the entries sorted by CRC, but don't rely on it
+        m_order.resize(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            m_order[i] = i;
+        }
+        stable_sort(m_order.begin(), m_order.end(), CompareCRC(m_entries));
     }
+    m_count = count;
+    m_file  = NULL;
+}
+
+bool StringList::exists(const std::string& name) const
+{
+    Index();
+
+    // The game finds strings by the CRC of their name as well;
+    // only names with the same CRC are compared.
+    const unsigned long crc = Utils::CRC32(name.c_str(), name.length());
+    size_t low = 0, high = m_count;
+    while (low < high)
+    {
+        const size_t mid = (low + high) / 2;
+        if (GetEntry(m_entries, GetIndex(mid)).crc < crc) low  = mid + 1;
+        else                                              high = mid;
+    }
+
+    for (; low < m_count; low++)
+    {
+        const size_t i = GetIndex(low);
+        if (GetEntry(m_entries, i).crc != crc) {
+            break;
+        }
+        if (m_offsets[i + 1] - m_offsets[i] == name.length() && memcmp(m_keys + m_offsets[i], name.c_str(), name.length()) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void StringList::GetNames(vector<string>& names) const
+{
+    Index();
+
+    for (size_t i = 0; i < m_count; i++)
+    {
+        names.push_back(string(m_keys + m_offsets[i], m_offsets[i + 1] - m_offsets[i]));
+    }
+}
+
+StringList::StringList(ptr<File> f)
+    : m_file(f), m_entries(NULL), m_keys(NULL), m_count(0)
+{
 }
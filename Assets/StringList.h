@@ -2,16 +2,36 @@
 #define ASSETS_STRINGLIST_H
 
 #include "Assets/Files.h"
-#include <map>
+#include <vector>
 
-class StringList
+//
+// The names of the strings in a MasterTextFile. The file is mapped and
+// indexed on first use, and searched in place; the localized text
+// itself is never touched.
+//
+class StringList : public Object
 {
-    std::map<std::string, std::wstring> m_strings;
+    mutable ptr<File>           m_file;     // Until it's mapped
+    mutable ptr<FileView>       m_view;
+    mutable const char*         m_entries;  // Entry table, in the view
+    mutable const char*         m_keys;     // Names, in the view
+    mutable size_t              m_count;
+    mutable std::vector<size_t> m_offsets;  // Offset of each name in m_keys, and the end
+    mutable std::vector<size_t> m_order;    // Entries by CRC; empty if the file has them sorted
+
+    size_t GetIndex(size_t position) const { return m_order.empty() ? position : m_order[position]; }
 
 public:
+    // Maps and indexes the file, if that hasn't been done yet. Lists are
+    // independent, so each can be indexed on its own thread.
+    void Index() const;
+
     bool exists(const std::string& name) const;
 
+    // Appends the names of all strings to the list
+    void GetNames(std::vector<std::string>& names) const;
+
     StringList(ptr<File> f);
 };
 
-#endif
\ No newline at end of file
+#endif
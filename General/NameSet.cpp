@@ -0,0 +1,96 @@
+#include "General/NameSet.h"
+#include <algorithm>
+#include <cctype>
+using namespace std;
+
+static const size_t EMPTY = (size_t)-1;
+
+static inline char Upper(char c)
+{
+    return (char)toupper((unsigned char)c);
+}
+
+// FNV-1a of the uppercased name
+static unsigned long Hash(const char* name, size_t length)
+{
+    unsigned long hash = 2166136261UL;
+    for (size_t i = 0; i < length; i++)
+    {
+        hash = (hash ^ (unsigned char)Upper(name[i])) * 16777619UL;
+    }
+    return hash;
+}
+
+// Compares an uppercased name from the set with a name of any case
+static bool Equals(const char* key, const char* name, size_t length)
+{
+    for (size_t i = 0; i < length; i++)
+    {
+        if (key[i] == '\0' || key[i] != Upper(name[i])) {
+            return false;
+        }
+    }
+    return key[length] == '\0';
+}
+
+// Returns the slot of the name, or the empty slot where it belongs
+size_t NameSet::find(const char* name, size_t length, unsigned long hash) const
+{
+    const size_t mask = m_slots.size() - 1;
+    size_t i = hash & mask;
+    while (m_slots[i].offset != EMPTY && (m_slots[i].hash != hash || !Equals(&m_names[m_slots[i].offset], name, length)))
+    {
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+void NameSet::grow()
+{
+    Slot empty = {0, EMPTY};
+    vector<Slot> slots(max<size_t>(16, m_slots.size() * 2), empty);
+    m_slots.swap(slots);
+
+    // The names are unique, so they only need an empty slot
+    const size_t mask = m_slots.size() - 1;
+    for (vector<Slot>::const_iterator p = slots.begin(); p != slots.end(); ++p)
+    {
+        if (p->offset != EMPTY)
+        {
+            size_t i = p->hash & mask;
+            while (m_slots[i].offset != EMPTY) {
+                i = (i + 1) & mask;
+            }
+            m_slots[i] = *p;
+        }
+    }
+}
+
+bool NameSet::insert(const string& name)
+{
+    // Keep the load factor at or below one half
+    if ((m_size + 1) * 2 > m_slots.size()) {
+        grow();
+    }
+
+    const unsigned long hash = Hash(name.c_str(), name.length());
+    const size_t i = find(name.c_str(), name.length(), hash);
+    if (m_slots[i].offset != EMPTY) {
+        return false;
+    }
+
+    m_slots[i].hash   = hash;
+    m_slots[i].offset = m_names.size();
+    for (string::const_iterator p = name.begin(); p != name.end(); ++p)
+    {
+        m_names.push_back(Upper(*p));
+    }
+    m_names.push_back('\0');
+    m_size++;
+    return true;
+}
+
+bool NameSet::exists(const string& name) const
+{
+    return !m_slots.empty() && m_slots[find(name.c_str(), name.length(), Hash(name.c_str(), name.length()))].offset != EMPTY;
+}
@@ -0,0 +1,40 @@
+#ifndef GENERAL_NAMESET_H
+#define GENERAL_NAMESET_H
+
+#include <string>
+#include <vector>
+
+//
+// A case-insensitive set of names, for the lists that are filled while
+// loading and searched from then on. The names are kept uppercased and
+// back to back in a single buffer, with an open-addressed hash table of
+// their offsets. Lookups hash and compare the query in place, so they
+// don't allocate or uppercase a copy of it.
+//
+class NameSet
+{
+    struct Slot
+    {
+        unsigned long hash;
+        size_t        offset;       // Of the name in m_names; EMPTY for empty slots
+    };
+
+    std::vector<char> m_names;      // Uppercased names, each ending in a NUL
+    std::vector<Slot> m_slots;      // Size is a power of two
+    size_t            m_size;
+
+    size_t find(const char* name, size_t length, unsigned long hash) const;
+    void   grow();
+
+public:
+    // Adds a name. Returns false if the set already has it.
+    bool insert(const std::string& name);
+
+    bool exists(const std::string& name) const;
+
+    size_t size() const { return m_size; }
+
+    NameSet() : m_size(0) {}
+};
+
+#endif
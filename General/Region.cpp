@@ -0,0 +1,193 @@
+#include "General/Region.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+using namespace std;
+
+// Chunks and large blocks start with a header of GRANULARITY bytes,
+// so the blocks after it keep the alignment of malloc.
+struct Region::Chunk
+{
+    Chunk* next;
+};
+
+struct Region::LargeBlock
+{
+    LargeBlock* prev;
+    LargeBlock* next;
+};
+
+// Returns the size class of a small block, or NUM_CLASSES for large blocks
+static inline size_t GetClass(size_t size, size_t granularity, size_t num_classes)
+{
+    return min((size + granularity - 1) / granularity - 1, num_classes);
+}
+
+void* Region::allocate(size_t size)
+{
+    assert(size > 0);
+    const size_t cls = GetClass(size, GRANULARITY, NUM_CLASSES);
+    if (cls < NUM_CLASSES)
+    {
+        // Small block; reuse a freed one, or carve it from the current chunk
+        void* block = m_free[cls];
+        if (block != NULL)
+        {
+            m_free[cls] = *(void**)block;
+            return block;
+        }
+
+        size = (cls + 1) * GRANULARITY;
+        if (size > (size_t)(m_end - m_next))
+        {
+            // Keep what's left of the current chunk for smaller blocks
+            const size_t left = m_end - m_next;
+            if (left >= GRANULARITY) {
+                free(m_next, left - left % GRANULARITY);
+            }
+
+            if (!can_grow(CHUNK_SIZE)) {
+                return NULL;
+            }
+            Chunk* chunk = (Chunk*)malloc(CHUNK_SIZE);
+            if (chunk == NULL) {
+                return NULL;
+            }
+            chunk->next = m_chunks;
+            m_chunks    = chunk;
+            m_next      = (char*)chunk + GRANULARITY;
+            m_end       = (char*)chunk + CHUNK_SIZE;
+            m_size     += CHUNK_SIZE;
+        }
+        block   = m_next;
+        m_next += size;
+        return block;
+    }
+
+    // Large block
+    if (!can_grow(size)) {
+        return NULL;
+    }
+    LargeBlock* large = (LargeBlock*)malloc(GRANULARITY + size);
+    if (large == NULL) {
+        return NULL;
+    }
+    large->prev = NULL;
+    large->next = m_large;
+    if (m_large != NULL) {
+        m_large->prev = large;
+    }
+    m_large = large;
+    m_size += size;
+    return (char*)large + GRANULARITY;
+}
+
+void Region::free(void* block, size_t size)
+{
+    if (block == NULL) {
+        return;
+    }
+
+    const size_t cls = GetClass(size, GRANULARITY, NUM_CLASSES);
+    if (cls < NUM_CLASSES)
+    {
+        *(void**)block = m_free[cls];
+        m_free[cls]    = block;
+        return;
+    }
+
+    LargeBlock* large = (LargeBlock*)((char*)block - GRANULARITY);
+    if (large->prev != NULL) {
+        large->prev->next = large->next;
+    } else {
+        m_large = large->next;
+    }
+    if (large->next != NULL) {
+        large->next->prev = large->prev;
+    }
+    m_size -= size;
+    ::free(large);
+}
+
+void* Region::reallocate(void* block, size_t oldsize, size_t size)
+{
+    if (block == NULL) {
+        return allocate(size);
+    }
+
+    if (size == 0) {
+        free(block, oldsize);
+        return NULL;
+    }
+
+    const size_t oldcls = GetClass(oldsize, GRANULARITY, NUM_CLASSES);
+    const size_t newcls = GetClass(size,    GRANULARITY, NUM_CLASSES);
+    if (oldcls == newcls && oldcls < NUM_CLASSES)
+    {
+        // Still fits
+        return block;
+    }
+
+    if (oldcls == NUM_CLASSES && newcls == NUM_CLASSES)
+    {
+        // Resize the large block in place, if the heap can
+        if (size > oldsize && !can_grow(size - oldsize)) {
+            return NULL;
+        }
+        LargeBlock* large = (LargeBlock*)realloc((char*)block - GRANULARITY, GRANULARITY + size);
+        if (large == NULL) {
+            return NULL;
+        }
+        if (large->prev != NULL) {
+            large->prev->next = large;
+        } else {
+            m_large = large;
+        }
+        if (large->next != NULL) {
+            large->next->prev = large;
+        }
+        m_size = m_size - oldsize + size;
+        return (char*)large + GRANULARITY;
+    }
+
+    void* newblock = allocate(size);
+    if (newblock != NULL)
+    {
+        memcpy(newblock, block, min(oldsize, size));
+        free(block, oldsize);
+    }
+    return newblock;
+}
+
+void Region::release()
+{
+    while (m_chunks != NULL)
+    {
+        Chunk* next = m_chunks->next;
+        ::free(m_chunks);
+        m_chunks = next;
+    }
+
+    while (m_large != NULL)
+    {
+        LargeBlock* next = m_large->next;
+        ::free(m_large);
+        m_large = next;
+    }
+
+    fill(m_free, m_free + NUM_CLASSES, (void*)NULL);
+    m_next = m_end = NULL;
+    m_size = 0;
+}
+
+Region::Region()
+    : m_chunks(NULL), m_next(NULL), m_end(NULL), m_large(NULL), m_size(0), m_limit(~(size_t)0)
+{
+    fill(m_free, m_free + NUM_CLASSES, (void*)NULL);
+}
+
+Region::~Region()
+{
+    release();
+}
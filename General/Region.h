@@ -0,0 +1,56 @@
+#ifndef GENERAL_REGION_H
+#define GENERAL_REGION_H
+
+#include <cstddef>
+
+//
+// An allocator for many small blocks that are released all at once.
+//
+// Small blocks are carved from large chunks with a pointer bump, and
+// freed small blocks are kept on a free list per size class for reuse.
+// Large blocks come from the heap, but are tracked so they're released
+// with the region as well. Callers pass the size of a block when freeing
+// or reallocating it, so blocks carry no header. Allocations that would
+// grow the region beyond its limit fail.
+//
+class Region
+{
+    static const size_t GRANULARITY = 16;
+    static const size_t NUM_CLASSES = 64;                           // Small blocks up to 1 KB
+    static const size_t CHUNK_SIZE  = 64 * 1024;
+
+    struct Chunk;
+    struct LargeBlock;
+
+    Chunk*      m_chunks;
+    char*       m_next;                 // Free space in the current chunk
+    char*       m_end;
+    void*       m_free[NUM_CLASSES];    // Free lists of small blocks
+    LargeBlock* m_large;
+    size_t      m_size;                 // Bytes in chunks and large blocks
+    size_t      m_limit;                // Maximum of m_size
+
+    // Checks if the region can grow by this many bytes
+    bool can_grow(size_t size) const { return m_size <= m_limit && size <= m_limit - m_size; }
+
+    Region(const Region&);
+    Region& operator=(const Region&);
+public:
+    void* allocate(size_t size);
+    void  free(void* block, size_t size);
+    void* reallocate(void* block, size_t oldsize, size_t size);
+
+    // Frees all blocks
+    void release();
+
+    // Returns the amount of memory held by the region, in bytes
+    size_t size() const { return m_size; }
+
+    // Sets the amount of memory the region may hold, in bytes
+    void limit(size_t size) { m_limit = size; }
+
+    Region();
+    ~Region();
+};
+
+#endif
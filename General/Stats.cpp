@@ -0,0 +1,227 @@
+#include "General/Stats.h"
+#include <string>
+#include <vector>
+#include <windows.h>
+using namespace std;
+
+namespace Stats {
+
+struct Phase
+{
+    string   name;
+    size_t   depth;
+    double   wall;      // Wall time, in seconds
+    double   cpu;       // User and kernel time, in seconds
+
+    double   start_wall;
+    double   start_cpu;
+};
+
+struct Wave
+{
+    size_t references;
+    size_t unchecked;
+};
+
+struct TypeCounters
+{
+    unsigned long checked;
+    unsigned long resolved;
+};
+
+// Updated from script checking threads as well
+struct ProbeCounters
+{
+    volatile LONG probes;
+    volatile LONG found;
+};
+
+static bool                 g_enabled = false;
+static vector<Phase>        g_phases;
+static size_t               g_depth = 0;
+static vector<Wave>         g_waves;
+static TypeCounters         g_types[256];
+static ProbeCounters        g_physical, g_virtual;
+static volatile LONGLONG     g_bytesRead = 0;
+static unsigned long        g_unitsReplayed = 0;
+static unsigned long        g_unitsParsed   = 0;
+
+static double GetWallTime()
+{
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart / frequency.QuadPart;
+}
+
+static double GetCPUTime()
+{
+    FILETIME creation, exit, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+    {
+        return 0.0;
+    }
+    // FILETIMEs are in units of 100 ns
+    const unsigned long long k = ((unsigned long long)kernel.dwHighDateTime << 32) | kernel.dwLowDateTime;
+    const unsigned long long u = ((unsigned long long)user.dwHighDateTime   << 32) | user.dwLowDateTime;
+    return (k + u) / 1e7;
+}
+
+void Enable()
+{
+    g_enabled = true;
+}
+
+bool IsEnabled()
+{
+    return g_enabled;
+}
+
+Timer::Timer(const char* name)
+    : m_phase(g_phases.size())
+{
+    if (g_enabled)
+    {
+        Phase phase;
+        phase.name       = name;
+        phase.depth      = g_depth++;
+        phase.wall       = 0.0;
+        phase.cpu        = 0.0;
+        phase.start_wall = GetWallTime();
+        phase.start_cpu  = GetCPUTime();
+        g_phases.push_back(phase);
+    }
+}
+
+Timer::~Timer()
+{
+    if (m_phase < g_phases.size())
+    {
+        Phase& phase = g_phases[m_phase];
+        phase.wall = GetWallTime() - phase.start_wall;
+        phase.cpu  = GetCPUTime()  - phase.start_cpu;
+        g_depth--;
+    }
+}
+
+void AddWave(size_t references, size_t unchecked)
+{
+    Wave wave = {references, unchecked};
+    g_waves.push_back(wave);
+}
+
+void AddCheck(int type, bool resolved)
+{
+    TypeCounters& counters = g_types[type & 0xFF];
+    counters.checked++;
+    if (resolved) {
+        counters.resolved++;
+    }
+}
+
+void AddFileProbe(bool physical, bool found)
+{
+    ProbeCounters& counters = physical ? g_physical : g_virtual;
+    InterlockedIncrement(&counters.probes);
+    if (found) {
+        InterlockedIncrement(&counters.found);
+    }
+}
+
+void AddBytesRead(size_t bytes)
+{
+    InterlockedExchangeAdd64(&g_bytesRead, (LONGLONG)bytes);
+}
+
+void AddUnit(bool replayed)
+{
+    if (replayed) {
+        g_unitsReplayed++;
+    } else {
+        g_unitsParsed++;
+    }
+}
+
+// Writes a string as a JSON string
+static void WriteString(ostream& os, const string& str)
+{
+    static const char* hex = "0123456789abcdef";
+
+    os << '"';
+    for (string::const_iterator p = str.begin(); p != str.end(); ++p)
+    {
+        const unsigned char c = *p;
+        if (c == '"' || c == '\\') {
+            os << '\\' << c;
+        } else if (c < 0x20) {
+            os << "\\u00" << hex[c >> 4] << hex[c & 15];
+        } else {
+            os << c;
+        }
+    }
+    os << '"';
+}
+
+static double GetRate(unsigned long part, unsigned long total)
+{
+    return (total > 0) ? (double)part / total : 0.0;
+}
+
+void Write(ostream& os, const char* (*GetTypeName)(int))
+{
+    const streamsize precision = os.precision(6);
+    const ios::fmtflags flags  = os.setf(ios::fixed, ios::floatfield);
+
+    os << "{" << endl;
+
+    os << "  \"phases\": [";
+    for (size_t i = 0; i < g_phases.size(); i++)
+    {
+        const Phase& phase = g_phases[i];
+        os << (i > 0 ? "," : "") << endl << "    {\"name\": ";
+        WriteString(os, phase.name);
+        os << ", \"depth\": " << phase.depth << ", \"wall\": " << phase.wall << ", \"cpu\": " << phase.cpu << "}";
+    }
+    os << endl << "  ]," << endl;
+
+    os << "  \"waves\": [";
+    for (size_t i = 0; i < g_waves.size(); i++)
+    {
+        os << (i > 0 ? "," : "") << endl << "    {\"references\": " << g_waves[i].references << ", \"unchecked\": " << g_waves[i].unchecked << "}";
+    }
+    os << endl << "  ]," << endl;
+
+    os << "  \"types\": {";
+    bool first = true;
+    for (int type = 0; type < 256; type++)
+    {
+        const TypeCounters& counters = g_types[type];
+        if (counters.checked > 0)
+        {
+            os << (first ? "" : ",") << endl << "    ";
+            WriteString(os, GetTypeName(type));
+            os << ": {\"checked\": " << counters.checked << ", \"resolved\": " << counters.resolved
+               << ", \"hit_rate\": " << GetRate(counters.resolved, counters.checked) << "}";
+            first = false;
+        }
+    }
+    os << endl << "  }," << endl;
+
+    os << "  \"files\": {" << endl
+       << "    \"physical\": {\"probes\": " << g_physical.probes << ", \"found\": " << g_physical.found
+       << ", \"hit_rate\": " << GetRate(g_physical.found, g_physical.probes) << "}," << endl
+       << "    \"virtual\": {\"probes\": "  << g_virtual.probes  << ", \"found\": " << g_virtual.found
+       << ", \"hit_rate\": " << GetRate(g_virtual.found, g_virtual.probes) << "}," << endl
+       << "    \"bytes_read\": " << g_bytesRead << endl
+       << "  }," << endl;
+
+    os << "  \"units\": {\"replayed\": " << g_unitsReplayed << ", \"parsed\": " << g_unitsParsed
+       << ", \"replay_rate\": " << GetRate(g_unitsReplayed, g_unitsReplayed + g_unitsParsed) << "}" << endl;
+
+    os << "}" << endl;
+
+    os.flags(flags);
+    os.precision(precision);
+}
+
+}
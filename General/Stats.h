@@ -0,0 +1,53 @@
+#ifndef GENERAL_STATS_H
+#define GENERAL_STATS_H
+
+#include <iostream>
+
+//
+// Run statistics, to see where a run spends its time.
+//
+// Counters are cheap and always collected. Phase timings are only
+// collected once enabled. Everything is written as JSON at the end.
+//
+namespace Stats
+{
+
+void Enable();
+bool IsEnabled();
+
+// Times the scope it's declared in as a phase. Phases can be nested.
+class Timer
+{
+    size_t m_phase;
+
+    Timer(const Timer&);
+    Timer& operator=(const Timer&);
+public:
+    explicit Timer(const char* name);
+    ~Timer();
+};
+
+// Records a wave of references during validation: the number of
+// references in the wave and how many of those weren't checked before.
+void AddWave(size_t references, size_t unchecked);
+
+// Records a checked reference of the specified type
+void AddCheck(int type, bool resolved);
+
+// Records an attempt to open a file in the search paths (physical)
+// or the MegaFile index (virtual)
+void AddFileProbe(bool physical, bool found);
+
+void AddBytesRead(size_t bytes);
+
+// Records a unit of the reference graph: replayed from the previous
+// run, or parsed again. See ReferenceGraph.
+void AddUnit(bool replayed);
+
+// Writes the statistics as JSON. GetTypeName returns the name of
+// a type passed to AddCheck.
+void Write(std::ostream& os, const char* (*GetTypeName)(int));
+
+}
+
+#endif
@@ -0,0 +1,202 @@
+#include "General/Suggestions.h"
+#include "General/Utils.h"
+#include <algorithm>
+#include <functional>
+using namespace std;
+
+// Maximum number of names that we compute the edit distance for per query
+static const size_t MAX_CANDIDATES = 16;
+
+// Trigrams that occur in more than 1/N of all names, and at least in this
+// many names, are considered too common to search
+static const size_t MAX_POSTING_FRACTION = 64;
+static const size_t MIN_COMMON_POSTINGS  = 1024;
+
+// Returns the maximum edit distance for a name of this length
+// to still be considered a typo of another name.
+static size_t GetMaxDistance(size_t length)
+{
+    return (length < 4) ? 1 : (length < 9) ? 2 : 3;
+}
+
+// Hashes the three characters at s into a bucket
+static inline unsigned int GetBucket(const char* s)
+{
+    unsigned int h = ((unsigned char)s[0] << 16) | ((unsigned char)s[1] << 8) | (unsigned char)s[2];
+    return (h * 2654435761u) >> 16;
+}
+
+// Returns the sorted, unique trigram buckets of a key. The key is padded
+// so that its start and end, and short keys, also produce trigrams.
+static void GetTrigrams(const string& key, vector<unsigned int>& buckets)
+{
+    const string padded = "  " + key + " ";
+
+    buckets.clear();
+    for (size_t i = 0; i + 3 <= padded.length(); i++)
+    {
+        buckets.push_back(GetBucket(&padded[i]));
+    }
+    sort(buckets.begin(), buckets.end());
+    buckets.erase(unique(buckets.begin(), buckets.end()), buckets.end());
+}
+
+// Computes the Levenshtein distance between a and b. Gives up as soon as
+// the distance is certain to exceed max, and returns max + 1 in that case.
+static size_t GetEditDistance(const string& a, const string& b, size_t max)
+{
+    if (a.length() > b.length() + max || b.length() > a.length() + max)
+    {
+        return max + 1;
+    }
+
+    vector<size_t> row(b.length() + 1);
+    for (size_t j = 0; j <= b.length(); j++)
+    {
+        row[j] = j;
+    }
+
+    for (size_t i = 1; i <= a.length(); i++)
+    {
+        size_t diag = row[0];
+        size_t best = row[0] = i;
+        for (size_t j = 1; j <= b.length(); j++)
+        {
+            const size_t up = row[j];
+            row[j] = min(min(up, row[j - 1]) + 1, diag + (a[i - 1] != b[j - 1] ? 1 : 0));
+            diag   = up;
+            best   = min(best, row[j]);
+        }
+
+        if (best > max)
+        {
+            return max + 1;
+        }
+    }
+    return min(row[b.length()], max + 1);
+}
+
+void SuggestionIndex::add(const string& name)
+{
+    m_names.push_back(name);
+    m_keys.push_back(Utils::Uppercase(name));
+}
+
+void SuggestionIndex::build()
+{
+    vector<unsigned int> buckets;
+
+    // Count the postings per bucket
+    m_offsets.assign(NUM_BUCKETS + 1, 0);
+    for (size_t i = 0; i < m_keys.size(); i++)
+    {
+        GetTrigrams(m_keys[i], buckets);
+        for (size_t j = 0; j < buckets.size(); j++)
+        {
+            m_offsets[buckets[j] + 1]++;
+        }
+    }
+
+    for (size_t i = 1; i <= NUM_BUCKETS; i++)
+    {
+        m_offsets[i] += m_offsets[i - 1];
+    }
+
+    // Fill the postings
+    vector<unsigned int> cursors(m_offsets.begin(), m_offsets.end() - 1);
+    m_postings.resize(m_offsets.back());
+    for (size_t i = 0; i < m_keys.size(); i++)
+    {
+        GetTrigrams(m_keys[i], buckets);
+        for (size_t j = 0; j < buckets.size(); j++)
+        {
+            m_postings[cursors[buckets[j]]++] = (unsigned int)i;
+        }
+    }
+
+    m_scores.assign(m_names.size(), 0);
+    m_touched.clear();
+}
+
+string SuggestionIndex::suggest(const string& name) const
+{
+    if (name.empty() || m_offsets.empty())
+    {
+        return "";
+    }
+
+    const string key = Utils::Uppercase(name);
+    const size_t limit = GetMaxDistance(key.length());
+
+    // Every edit changes at most three trigrams, so a name within the maximum
+    // distance shares all but 3 * limit of the key's trigrams. Such a name must
+    // then appear in at least one of the (3 * limit + 1) least common trigrams,
+    // so we only need to walk those posting lists to find the candidates.
+    // Trigrams shared by a large part of all names (e.g. "_UN" in "_UNIT")
+    // say little about similarity and are skipped as long as there's a rarer one.
+    vector<unsigned int> buckets;
+    GetTrigrams(key, buckets);
+
+    vector< pair<unsigned int, unsigned int> > lists;
+    for (size_t i = 0; i < buckets.size(); i++)
+    {
+        lists.push_back(make_pair(m_offsets[buckets[i] + 1] - m_offsets[buckets[i]], buckets[i]));
+    }
+    sort(lists.begin(), lists.end());
+    lists.resize(min(lists.size(), 3 * limit + 1));
+
+    const size_t common = max(m_names.size() / MAX_POSTING_FRACTION, MIN_COMMON_POSTINGS);
+    while (lists.size() > 1 && lists.back().first > common)
+    {
+        lists.pop_back();
+    }
+
+    // Count the shared trigrams in those lists
+    for (size_t i = 0; i < lists.size(); i++)
+    {
+        const unsigned int bucket = lists[i].second;
+        for (unsigned int p = m_offsets[bucket]; p < m_offsets[bucket + 1]; p++)
+        {
+            const unsigned int index = m_postings[p];
+            if (m_scores[index]++ == 0)
+            {
+                m_touched.push_back(index);
+            }
+        }
+    }
+
+    // Keep the names with the most shared trigrams that could be close enough
+    vector< pair<unsigned short, unsigned int> > candidates;
+    for (size_t i = 0; i < m_touched.size(); i++)
+    {
+        const unsigned int index = m_touched[i];
+        const size_t length = m_keys[index].length();
+        if (length + limit >= key.length() && length <= key.length() + limit)
+        {
+            candidates.push_back(make_pair(m_scores[index], index));
+        }
+        m_scores[index] = 0;
+    }
+    m_touched.clear();
+
+    const size_t count = min(candidates.size(), MAX_CANDIDATES);
+    partial_sort(candidates.begin(), candidates.begin() + count, candidates.end(), greater< pair<unsigned short, unsigned int> >());
+
+    // Of those, find the one with the smallest edit distance
+    size_t best = m_names.size(), distance = limit;
+    for (size_t i = 0; i < count; i++)
+    {
+        const size_t d = GetEditDistance(key, m_keys[candidates[i].second], distance);
+        if (d < distance || (d == distance && best == m_names.size()))
+        {
+            best     = candidates[i].second;
+            distance = d;
+        }
+    }
+
+    if (best == m_names.size() || m_names[best] == name)
+    {
+        return "";
+    }
+    return m_names[best];
+}
@@ -0,0 +1,41 @@
+#ifndef GENERAL_SUGGESTIONS_H
+#define GENERAL_SUGGESTIONS_H
+
+#include <string>
+#include <vector>
+
+//
+// Finds the closest known name for a misspelled name.
+//
+// Names are indexed by their (case-insensitive) trigrams. A query only
+// computes the edit distance to the few names that share the most trigrams
+// with it, so a lookup costs a handful of posting list walks instead of
+// an edit distance computation against every known name.
+//
+class SuggestionIndex
+{
+    static const size_t NUM_BUCKETS = 1 << 16;
+
+    std::vector<std::string>  m_names;      // Names, as added
+    std::vector<std::string>  m_keys;       // Uppercased names
+    std::vector<unsigned int> m_offsets;    // Start of each bucket's postings
+    std::vector<unsigned int> m_postings;   // Name indices, grouped by bucket
+
+    // Scratch space for queries
+    mutable std::vector<unsigned short> m_scores;
+    mutable std::vector<unsigned int>   m_touched;
+
+public:
+    void add(const std::string& name);
+
+    // Builds the trigram index. Must be called after adding all names.
+    void build();
+
+    // Returns the name closest to the specified name, or an empty
+    // string if no name is close enough to be a likely typo.
+    std::string suggest(const std::string& name) const;
+
+    bool empty() const { return m_names.empty(); }
+};
+
+#endif
@@ -0,0 +1,139 @@
+#include "General/ThreadPool.h"
+#include <queue>
+#include <vector>
+#include <stdexcept>
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+using namespace std;
+
+struct ThreadPool::Impl
+{
+    struct Worker
+    {
+        Impl*  pool;
+        size_t index;
+    };
+
+    vector<Worker>     m_workers;
+    vector<HANDLE>     m_threads;
+    queue<Job*>        m_jobs;
+    size_t             m_pending;   // Jobs that are queued or running
+    bool               m_stop;
+    CRITICAL_SECTION   m_lock;
+    CONDITION_VARIABLE m_jobAdded;
+    CONDITION_VARIABLE m_jobsDone;
+
+    static DWORD WINAPI ThreadProc(LPVOID param)
+    {
+        const Worker& worker = *(const Worker*)param;
+        Impl&         pool   = *worker.pool;
+
+        EnterCriticalSection(&pool.m_lock);
+        for (;;)
+        {
+            while (pool.m_jobs.empty() && !pool.m_stop)
+            {
+                SleepConditionVariableCS(&pool.m_jobAdded, &pool.m_lock, INFINITE);
+            }
+
+            if (pool.m_jobs.empty())
+            {
+                // Stopping
+                break;
+            }
+
+            Job* job = pool.m_jobs.front();
+            pool.m_jobs.pop();
+
+            LeaveCriticalSection(&pool.m_lock);
+            job->Run(worker.index);
+            EnterCriticalSection(&pool.m_lock);
+
+            if (--pool.m_pending == 0)
+            {
+                WakeAllConditionVariable(&pool.m_jobsDone);
+            }
+        }
+        LeaveCriticalSection(&pool.m_lock);
+        return 0;
+    }
+
+    Impl(size_t threads)
+        : m_workers(threads), m_pending(0), m_stop(false)
+    {
+        InitializeCriticalSection(&m_lock);
+        InitializeConditionVariable(&m_jobAdded);
+        InitializeConditionVariable(&m_jobsDone);
+
+        for (size_t i = 0; i < threads; i++)
+        {
+            m_workers[i].pool  = this;
+            m_workers[i].index = i;
+
+            HANDLE hThread = CreateThread(NULL, 0, ThreadProc, &m_workers[i], 0, NULL);
+            if (hThread == NULL)
+            {
+                Stop();
+                throw runtime_error("Unable to create worker thread");
+            }
+            m_threads.push_back(hThread);
+        }
+    }
+
+    void Stop()
+    {
+        EnterCriticalSection(&m_lock);
+        m_stop = true;
+        WakeAllConditionVariable(&m_jobAdded);
+        LeaveCriticalSection(&m_lock);
+
+        for (size_t i = 0; i < m_threads.size(); i++)
+        {
+            WaitForSingleObject(m_threads[i], INFINITE);
+            CloseHandle(m_threads[i]);
+        }
+        DeleteCriticalSection(&m_lock);
+    }
+};
+
+void ThreadPool::add(Job* job)
+{
+    EnterCriticalSection(&m_impl->m_lock);
+    m_impl->m_jobs.push(job);
+    m_impl->m_pending++;
+    WakeConditionVariable(&m_impl->m_jobAdded);
+    LeaveCriticalSection(&m_impl->m_lock);
+}
+
+void ThreadPool::wait()
+{
+    EnterCriticalSection(&m_impl->m_lock);
+    while (m_impl->m_pending > 0)
+    {
+        SleepConditionVariableCS(&m_impl->m_jobsDone, &m_impl->m_lock, INFINITE);
+    }
+    LeaveCriticalSection(&m_impl->m_lock);
+}
+
+size_t ThreadPool::size() const
+{
+    return m_impl->m_workers.size();
+}
+
+size_t ThreadPool::GetNumProcessors()
+{
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return max<size_t>(info.dwNumberOfProcessors, 1);
+}
+
+ThreadPool::ThreadPool(size_t threads)
+    : m_impl(new Impl(max<size_t>(threads, 1)))
+{
+}
+
+ThreadPool::~ThreadPool()
+{
+    m_impl->Stop();
+    delete m_impl;
+}
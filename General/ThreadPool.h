@@ -0,0 +1,45 @@
+#ifndef GENERAL_THREADPOOL_H
+#define GENERAL_THREADPOOL_H
+
+#include <cstddef>
+
+// A unit of work for the thread pool
+class Job
+{
+public:
+    // Runs the job on the worker with the specified index
+    virtual void Run(size_t worker) = 0;
+    virtual ~Job() {}
+};
+
+//
+// A fixed set of worker threads that run queued jobs.
+// Each worker runs one job at a time, so jobs can safely use
+// per-worker state by indexing it with the worker index.
+//
+class ThreadPool
+{
+    struct Impl;
+    Impl* m_impl;
+
+    ThreadPool(const ThreadPool&);
+    ThreadPool& operator=(const ThreadPool&);
+public:
+    // Queues a job. The caller keeps ownership, and must keep
+    // the job alive until wait() has returned.
+    void add(Job* job);
+
+    // Waits until all queued jobs have been run
+    void wait();
+
+    size_t size() const;
+
+    // Returns the number of processors in the system
+    static size_t GetNumProcessors();
+
+    // Creates a pool with the specified number of worker threads (at least one)
+    explicit ThreadPool(size_t threads);
+    ~ThreadPool();
+};
+
+#endif
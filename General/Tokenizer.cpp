@@ -0,0 +1,262 @@
+#include "General/Tokenizer.h"
+#include "General/ExactTypes.h"
+using namespace std;
+
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#include <intrin.h>
+#define TOKENIZER_SSE2
+#if _MSC_VER >= 1700
+// The AVX2 intrinsics and _xgetbv need Visual Studio 2012 or later
+#define TOKENIZER_AVX2
+#endif
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define TOKENIZER_SSE2
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define TOKENIZER_AVX2
+#endif
+#endif
+
+namespace Tokenizer {
+
+#ifdef TOKENIZER_SSE2
+// Returns the bits of the characters in [lo, hi]
+static inline __m128i InRange(__m128i v, char lo, char hi)
+{
+    const __m128i t = _mm_sub_epi8(v, _mm_set1_epi8(lo));
+    return _mm_cmpeq_epi8(_mm_min_epu8(t, _mm_set1_epi8(hi - lo)), t);
+}
+#endif
+
+#ifdef TOKENIZER_AVX2
+static inline __m256i InRange(__m256i v, char lo, char hi)
+{
+    const __m256i t = _mm256_sub_epi8(v, _mm256_set1_epi8(lo));
+    return _mm256_cmpeq_epi8(_mm256_min_epu8(t, _mm256_set1_epi8(hi - lo)), t);
+}
+#endif
+
+//
+// Each scanner is described by a "stop" class that, for a character or
+// a block of characters, tells where the scan should stop. Stop classes
+// must always stop at the terminating NUL.
+//
+struct StopAtNonIdent
+{
+    bool operator()(char c) const { return !IsIdent(c); }
+
+#ifdef TOKENIZER_SSE2
+    // Returns the bits of the identifier characters (see IsIdent)
+    unsigned int operator()(__m128i v) const
+    {
+        __m128i r =      InRange(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 'z');
+        r = _mm_or_si128(r, InRange(v, '-', '9'));
+        r = _mm_or_si128(r, _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+        r = _mm_or_si128(r, _mm_cmpeq_epi8(v, _mm_set1_epi8('\\')));
+        return ~_mm_movemask_epi8(r) & 0xFFFF;
+    }
+#endif
+
+#ifdef TOKENIZER_AVX2
+    uint32_t operator()(__m256i v) const
+    {
+        __m256i r =         InRange(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), 'a', 'z');
+        r = _mm256_or_si256(r, InRange(v, '-', '9'));
+        r = _mm256_or_si256(r, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')));
+        r = _mm256_or_si256(r, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\')));
+        return ~(uint32_t)_mm256_movemask_epi8(r);
+    }
+#endif
+};
+
+struct StopAtNonSpace
+{
+    bool operator()(char c) const { return !IsSpace(c); }
+
+#ifdef TOKENIZER_SSE2
+    unsigned int operator()(__m128i v) const
+    {
+        const __m128i r = _mm_or_si128(InRange(v, '\t', '\r'), _mm_cmpeq_epi8(v, _mm_set1_epi8(' ')));
+        return ~_mm_movemask_epi8(r) & 0xFFFF;
+    }
+#endif
+
+#ifdef TOKENIZER_AVX2
+    uint32_t operator()(__m256i v) const
+    {
+        const __m256i r = _mm256_or_si256(InRange(v, '\t', '\r'), _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')));
+        return ~(uint32_t)_mm256_movemask_epi8(r);
+    }
+#endif
+};
+
+struct StopAtChar
+{
+    char m_char;
+
+    bool operator()(char c) const { return c == m_char || c == '\0'; }
+
+#ifdef TOKENIZER_SSE2
+    unsigned int operator()(__m128i v) const
+    {
+        const __m128i r = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(m_char)), _mm_cmpeq_epi8(v, _mm_setzero_si128()));
+        return _mm_movemask_epi8(r);
+    }
+#endif
+
+#ifdef TOKENIZER_AVX2
+    uint32_t operator()(__m256i v) const
+    {
+        const __m256i r = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(m_char)), _mm256_cmpeq_epi8(v, _mm256_setzero_si256()));
+        return (uint32_t)_mm256_movemask_epi8(r);
+    }
+#endif
+
+    StopAtChar(char c) : m_char(c) {}
+};
+
+// Returns the index of the lowest set bit. Mask must be non-zero.
+static inline unsigned int LowestBit(uint32_t mask)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return index;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+template <typename Stop>
+static const char* Scan_Scalar(const char* s, const Stop& stop)
+{
+    while (!stop(*s)) s++;
+    return s;
+}
+
+//
+// The vectorized scanners read whole blocks, so they read past the NUL.
+// This is safe because they only do aligned loads: pages are a multiple of
+// the block size, so an aligned load never crosses a page boundary, and a
+// block that holds the NUL is always in a page that can be read.
+// The bits of the characters before the start in the first block are masked.
+//
+#ifdef TOKENIZER_SSE2
+template <typename Stop>
+static const char* Scan_SSE2(const char* s, const Stop& stop)
+{
+    const unsigned int offset = (unsigned int)((uintptr_t)s & 15);
+    const char* p = s - offset;
+
+    unsigned int mask = stop(_mm_load_si128((const __m128i*)p)) & (0xFFFFu << offset);
+    while (mask == 0)
+    {
+        p   += 16;
+        mask = stop(_mm_load_si128((const __m128i*)p));
+    }
+    return p + LowestBit(mask);
+}
+#endif
+
+#ifdef TOKENIZER_AVX2
+template <typename Stop>
+static const char* Scan_AVX2(const char* s, const Stop& stop)
+{
+    const unsigned int offset = (unsigned int)((uintptr_t)s & 31);
+    const char* p = s - offset;
+
+    uint32_t mask = stop(_mm256_load_si256((const __m256i*)p)) & (0xFFFFFFFFu << offset);
+    while (mask == 0)
+    {
+        p   += 32;
+        mask = stop(_mm256_load_si256((const __m256i*)p));
+    }
+    _mm256_zeroupper();
+    return p + LowestBit(mask);
+}
+
+// Checks if the CPU and OS support AVX2
+static bool HasAVX2()
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+    {
+        return false;
+    }
+
+    // The OS must save the YMM registers (OSXSAVE and AVX, then XCR0)
+    __cpuid(info, 1);
+    if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0 || (_xgetbv(0) & 6) != 6)
+    {
+        return false;
+    }
+
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    // Compiled for AVX2
+    return true;
+#endif
+}
+
+static const bool UseAVX2 = HasAVX2();
+#endif
+
+template <typename Stop>
+static inline const char* Scan(const char* s, const Stop& stop)
+{
+#ifdef TOKENIZER_AVX2
+    if (UseAVX2) {
+        return Scan_AVX2(s, stop);
+    }
+#endif
+#ifdef TOKENIZER_SSE2
+    return Scan_SSE2(s, stop);
+#else
+    return Scan_Scalar(s, stop);
+#endif
+}
+
+const char* SkipIdent(const char* s)
+{
+    return Scan(s, StopAtNonIdent());
+}
+
+const char* SkipSpace(const char* s)
+{
+    // Separators are usually followed by zero or one whitespace character
+    return IsSpace(*s) ? Scan(s + 1, StopAtNonSpace()) : s;
+}
+
+const char* FindChar(const char* s, char c)
+{
+    return Scan(s, StopAtChar(c));
+}
+
+void Split(const char* str, char separator, vector<Token>& tokens)
+{
+    for (const char* s = str;;)
+    {
+        const char* start = SkipSpace(s);
+        const char* end   = FindChar(start, separator);
+        const char* next  = end;
+
+        // Trim the whitespace at the end
+        while (end > start && IsSpace(*(end - 1))) end--;
+        if (end > start)
+        {
+            tokens.push_back(Token(start, end - start));
+        }
+
+        if (*next == '\0')
+        {
+            break;
+        }
+        s = next + 1;
+    }
+}
+
+}
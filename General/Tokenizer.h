@@ -0,0 +1,54 @@
+#ifndef GENERAL_TOKENIZER_H
+#define GENERAL_TOKENIZER_H
+
+#include <string>
+#include <vector>
+
+//
+// Scanners for splitting tag data into tokens.
+//
+// The scanners process 16 (SSE2) or 32 (AVX2) characters at a time where
+// the CPU supports it. All strings must be NUL-terminated; the scanners
+// never stop past the terminator.
+//
+namespace Tokenizer
+{
+
+// A view on a part of a string
+struct Token
+{
+    const char* data;
+    size_t      length;
+
+    std::string str() const { return std::string(data, length); }
+
+    Token(const char* data, size_t length) : data(data), length(length) {}
+};
+
+// Identifier characters are alphanumerics and _ . \ / -
+inline bool IsIdent(char c)
+{
+    return (unsigned char)((c | 0x20) - 'a') < 26 || (unsigned char)(c - '-') <= '9' - '-' || c == '_' || c == '\\';
+}
+
+inline bool IsSpace(char c)
+{
+    return c == ' ' || (unsigned char)(c - '\t') <= '\r' - '\t';
+}
+
+// Returns the first character at or after s that is not an identifier character
+const char* SkipIdent(const char* s);
+
+// Returns the first character at or after s that is not whitespace
+const char* SkipSpace(const char* s);
+
+// Returns the first occurrence of c at or after s, or the terminating NUL
+const char* FindChar(const char* s, char c);
+
+// Splits a string on a separator into tokens with the surrounding whitespace
+// trimmed. Empty tokens are skipped. The tokens are appended to the list.
+void Split(const char* str, char separator, std::vector<Token>& tokens);
+
+}
+
+#endif
@@ -1,8 +1,13 @@
 #include "Mod.h"
+#include "ReferenceGraph.h"
 #include "Assets/Assets.h"
 #include "General/Utils.h"
 #include "General/Exceptions.h"
+#include "General/Stats.h"
+#include "General/Tokenizer.h"
 #include <cassert>
+#include <exception>
+#include <iterator>
 #include <queue>
 #include <sstream>
 #include <windows.h>
@@ -20,9 +25,13 @@ static void error(const Location& loc, const string& message)
     cerr << message << endl;
 }
 
-static void unknown(const Location& loc, const char* type, const string& name)
+static void unknown(const Location& loc, const char* type, const string& name, const string& suggestion = "")
 {
-    error(loc, string("unknown ") + type + " \"" + name + "\"");
+    if (suggestion.empty()) {
+        error(loc, string("unknown ") + type + " \"" + name + "\"");
+    } else {
+        error(loc, string("unknown ") + type + " \"" + name + "\" (did you mean \"" + suggestion + "\"?)");
+    }
 }
 
 static void unknown_crc(const Location& loc, unsigned long crc, const ChecksumMap& reference)
@@ -47,43 +56,68 @@ static void duplicate(const Location& loc, const string& type, const string& nam
     error(previous, "previous declaration was here");
 }
 
-static bool isident(int c)
-{
-    return isalnum(c) || c == '_' || c == '.' || c == '\\' || c == '/' || c == '-';
-}
-
-static ptr<File> LoadAsset(const Reference& ref, bool error = true)
+// Returns the asset type of a file reference
+static Assets::AssetType GetAssetType(ObjType type)
 {
-    ptr<File> (*loader)(const string&) = NULL;
-    switch (ref.id.type)
+    switch (type)
     {
-        case OBJ_FILE:      loader = &Assets::LoadFile; break;
-        case OBJ_TEXTURE:   loader = &Assets::LoadTexture; break;
-        case OBJ_SFX:       loader = &Assets::LoadSFX; break;
-        case OBJ_MUSIC:     loader = &Assets::LoadMusic; break;
-        case OBJ_SPEECH:    loader = &Assets::LoadSpeech; break;
-        case OBJ_CINEMATIC: loader = &Assets::LoadCinematic; break;
-        case OBJ_MAP:       loader = &Assets::LoadMap; break;
-        case OBJ_ANIMATION: loader = &Assets::LoadAnimation; break;
+        case OBJ_FILE:      return Assets::ASSET_FILE;
+        case OBJ_TEXTURE:   return Assets::ASSET_TEXTURE;
+        case OBJ_SFX:       return Assets::ASSET_SFX;
+        case OBJ_MUSIC:     return Assets::ASSET_MUSIC;
+        case OBJ_SPEECH:    return Assets::ASSET_SPEECH;
+        case OBJ_CINEMATIC: return Assets::ASSET_CINEMATIC;
+        case OBJ_MAP:       return Assets::ASSET_MAP;
+        case OBJ_ANIMATION: return Assets::ASSET_ANIMATION;
         case OBJ_MODEL_OR_PARTICLE:
         case OBJ_PARTICLE:
-        case OBJ_MODEL:     loader = &Assets::LoadModelParticle; break;
-        case OBJ_SCRIPT:    loader = &Assets::LoadScript; break;
-        case OBJ_SHADER:    loader = &Assets::LoadShader; break;
+        case OBJ_MODEL:     return Assets::ASSET_MODEL_PARTICLE;
+        case OBJ_SCRIPT:    return Assets::ASSET_SCRIPT;
+        case OBJ_SHADER:    return Assets::ASSET_SHADER;
         case OBJ_STORY_PLOT:
         case OBJ_STORY:
         case OBJ_GOAL_SET:
-        case OBJ_XML:       loader = &Assets::LoadXML; break;
-        default:
-            assert(0);
-            return NULL;
+        case OBJ_XML:       return Assets::ASSET_XML;
     }
-    ptr<File> f = loader(ref.id.name);
-    if (f == NULL && error)
+    assert(0);
+    return Assets::ASSET_FILE;
+}
+
+// Checks that a referenced file exists, without opening it
+static bool CheckAsset(const Reference& ref)
+{
+    return Assets::Exists(GetAssetType(ref.id.type), ref.id.name);
+}
+
+// Checks the audio file references of a wave, with one batch per type.
+// Mods have many thousands of these, so they aren't checked one by one.
+static void CheckAudio(const vector<const Reference*>& refs)
+{
+    static const ObjType Types[] = {OBJ_SFX, OBJ_MUSIC, OBJ_SPEECH};
+    for (size_t t = 0; t < sizeof Types / sizeof Types[0]; t++)
     {
-        unknown(ref.location, GetObjTypeName(ref.id.type), ref.id.name);
+        vector<const Reference*> batch;
+        vector<string>           names;
+        for (vector<const Reference*>::const_iterator r = refs.begin(); r != refs.end(); ++r)
+        {
+            if ((*r)->id.type == Types[t]) {
+                batch.push_back(*r);
+                names.push_back((*r)->id.name);
+            }
+        }
+
+        if (!batch.empty())
+        {
+            const vector<bool> found = Assets::Exists(GetAssetType(Types[t]), names);
+            for (size_t i = 0; i < batch.size(); i++)
+            {
+                if (!found[i]) {
+                    unknown(batch[i]->location, GetObjTypeName(Types[t]), batch[i]->id.name);
+                }
+                Stats::AddCheck(Types[t], found[i]);
+            }
+        }
     }
-    return f;
 }
 
 static bool CheckMTD(const Reference& ref, auto_ptr<MegaTextureDirectory>& mtd)
@@ -91,14 +125,36 @@ static bool CheckMTD(const Reference& ref, auto_ptr<MegaTextureDirectory>& mtd)
     return (mtd.get() != NULL && mtd->exists(ref.id.name));
 }
 
-static bool CheckString(const Reference& ref, auto_ptr<StringList>& strings)
+// Checks a string in every language. A string that's missing in only some
+// languages is added to their lists in missing, and isn't an error by itself.
+static bool CheckString(const Reference& ref, const vector<ptr<StringList> >& strings, vector<vector<const Reference*> >& missing)
 {
-    return (strings.get() != NULL && strings->exists(ref.id.name));
+    unsigned long absent = 0;
+    size_t        count  = 0;
+    for (size_t i = 0; i < strings.size(); i++)
+    {
+        if (!strings[i]->exists(ref.id.name)) {
+            absent |= 1UL << i;
+            count++;
+        }
+    }
+
+    if (count == strings.size()) {
+        return false;
+    }
+
+    for (size_t i = 0; i < strings.size(); i++)
+    {
+        if (absent & (1UL << i)) {
+            missing[i].push_back(&ref);
+        }
+    }
+    return true;
 }
 
-static bool CheckDefinition(const Reference& ref, DefinitionList& definitions)
+static bool CheckDefinition(const Reference& ref, const DefinitionList& definitions)
 {
-    return definitions.find(Utils::Uppercase(ref.id.name)) != definitions.end();
+    return definitions.exists(ref.id.name);
 }
 
 static bool CheckBuiltin(const Reference& ref, const BuiltinInfo& info, GameID game, bool error = true)
@@ -134,73 +190,434 @@ static const ModObject* FindObject(const Reference& ref, const ObjectList& objec
     return NULL;
 }
 
-void ReferenceList::add(const Location& location, const std::string& value, const char* pattern, const char* prefix)
+void ChecksumIndex::build(const ObjectList& objects)
+{
+    // Keep the load factor at or below one half
+    size_t size = 16;
+    while (size < objects.size() * 2) size *= 2;
+
+    Slot empty = {0, NULL};
+    m_slots.assign(size, empty);
+    m_mask = size - 1;
+
+    for (ObjectList::const_iterator p = objects.begin(); p != objects.end(); ++p)
+    {
+        // CRCs are already well distributed, so use them directly as hash
+        unsigned long crc = Utils::CRC32(p->first.c_str(), p->first.length());
+        size_t i = crc & m_mask;
+        while (m_slots[i].object != NULL && m_slots[i].crc != crc) {
+            i = (i + 1) & m_mask;
+        }
+        if (m_slots[i].object == NULL) {
+            m_slots[i].crc    = crc;
+            m_slots[i].object = &p->second;
+        }
+    }
+}
+
+const ModObject* ChecksumIndex::find(unsigned long crc) const
+{
+    if (!m_slots.empty())
+    {
+        for (size_t i = crc & m_mask; m_slots[i].object != NULL; i = (i + 1) & m_mask)
+        {
+            if (m_slots[i].crc == crc) {
+                return m_slots[i].object;
+            }
+        }
+    }
+    return NULL;
+}
+
+// The object and definition lists that units add to, by their index in the
+// reference graph. Changing them changes the graph format; see GRAPH_VERSION.
+ObjectList Mod::* const Mod::ObjectLists[] = {
+    &Mod::m_gameObjects,        &Mod::m_radarMapEvents,     &Mod::m_factions,           &Mod::m_abilities,
+    &Mod::m_sfxEvents,          &Mod::m_surfaceFXs,         &Mod::m_dynamicTracks,      &Mod::m_terrainDecals,
+    &Mod::m_lightningEffects,   &Mod::m_shadowBlobs,        &Mod::m_musicEvents,        &Mod::m_speechEvents,
+    &Mod::m_movies,             &Mod::m_textCrawls,         &Mod::m_tradeRoutes,        &Mod::m_campaigns,
+    &Mod::m_aiPlayers,          &Mod::m_maps,               &Mod::m_aiTemplates,        &Mod::m_goalSets,
+    &Mod::m_lensFlares,         &Mod::m_goals,              &Mod::m_equations,          &Mod::m_commandbarComponents,
+    &Mod::m_weatherScenarios,   &Mod::m_hardpoints,         &Mod::m_blackMarketItems,   &Mod::m_difficulties,
+    &Mod::m_tacticalCameras,    &Mod::m_tradeRouteLines,    &Mod::m_targetingPriorities,&Mod::m_mousePointers,
+    &Mod::m_weatherModifiers,   &Mod::m_heroClashes,
+};
+
+DefinitionList Mod::* const Mod::DefinitionLists[] = {
+    &Mod::m_damageTypes,        &Mod::m_armorTypes,         &Mod::m_surfaceFXTriggerTypes,  &Mod::m_categories,
+    &Mod::m_gameObjectProperties, &Mod::m_movementClasses,  &Mod::m_aiGoalCategoryTypes,
+};
+
+//
+// Parsing or checking one file, as a unit of the reference graph. If the graph
+// of the previous run has the unit, and the files it read and the names it
+// looked up are as they were, the unit is replayed: its report is written and
+// what it added is added again, without reading the file. Otherwise the file
+// is parsed as usual, and the unit records what happens until it ends.
+//
+struct Mod::Unit
+{
+    // An object that the unit added, or added to, as it was before
+    struct Touched
+    {
+        bool        created;
+        size_t      references;
+        std::string name;
+    };
+    typedef map<pair<int, string>, Touched> TouchedMap;
+
+    Mod&                    mod;
+    string                  key;
+    bool                    replayed;
+    GraphUnit               record;
+    auto_ptr<StreamCapture> report;
+    TouchedMap              touched;
+    size_t                  globals;    // Root and on-demand references before the unit
+    size_t                  demands;
+
+    static const size_t NUM_OBJECT_LISTS     = sizeof ObjectLists     / sizeof ObjectLists[0];
+    static const size_t NUM_DEFINITION_LISTS = sizeof DefinitionLists / sizeof DefinitionLists[0];
+
+    template <typename T, size_t N>
+    static int GetIndex(const Mod& mod, T Mod::* const (&lists)[N], const T& list)
+    {
+        for (size_t i = 0; i < N; i++)
+        {
+            if (&(mod.*lists[i]) == &list) {
+                return (int)i;
+            }
+        }
+        assert(0);
+        return -1;
+    }
+
+    bool IsCurrent(const GraphUnit& unit, const File* file) const;
+    void Replay(const GraphUnit& unit);
+
+    // Records a lookup of a key in an object list, or an insert of it
+    void Lookup(const ObjectList& objects, const string& key, bool insert, bool found);
+    void Define(const DefinitionList& definitions, const string& name, bool inserted);
+
+    // The key identifies the parse: the kind of parse, the file's name and where it's referenced.
+    // The file is the file to check, if the caller loaded it already.
+    Unit(Mod& mod, const string& kind, const Location& location, const string& name, const File* file = NULL);
+    ~Unit();
+};
+
+bool Mod::Unit::IsCurrent(const GraphUnit& unit, const File* file) const
+{
+    for (size_t i = 0; i < unit.dependencies.size(); i++)
+    {
+        if (!unit.dependencies[i].IsCurrent(i == 0 ? file : NULL)) {
+            return false;
+        }
+    }
+
+    // Replay the lookups. Names that the unit added itself aren't in the lists yet.
+    set<pair<int, string> > added;
+    for (vector<GraphLookup>::const_iterator p = unit.lookups.begin(); p != unit.lookups.end(); ++p)
+    {
+        bool found;
+        if (p->definition)
+        {
+            if (p->list < 0 || (size_t)p->list >= NUM_DEFINITION_LISTS) {
+                return false;
+            }
+            const pair<int, string> name(-1 - p->list, Utils::Uppercase(p->key));
+            found = (added.find(name) != added.end() || (mod.*DefinitionLists[p->list]).exists(p->key));
+            if (p->insert && !found) {
+                added.insert(name);
+            }
+        }
+        else
+        {
+            if (p->list < 0 || (size_t)p->list >= NUM_OBJECT_LISTS) {
+                return false;
+            }
+            const pair<int, string> name(p->list, p->key);
+            const ObjectList& objects = mod.*ObjectLists[p->list];
+            ObjectList::const_iterator q = objects.find(p->key);
+            if (added.find(name) != added.end()) {
+                found = true;
+            } else if (q != objects.end()) {
+                // Duplicates are reported with the location of the first declaration
+                if (q->second.m_location != p->location) {
+                    return false;
+                }
+                found = true;
+            } else {
+                found = false;
+            }
+            if (p->insert && !found) {
+                added.insert(name);
+            }
+        }
+
+        if (found != p->found) {
+            return false;
+        }
+    }
+
+    for (vector<GraphObject>::const_iterator p = unit.objects.begin(); p != unit.objects.end(); ++p)
+    {
+        if (p->list < 0 || (size_t)p->list >= NUM_OBJECT_LISTS) {
+            return false;
+        }
+    }
+    for (vector<pair<int, string> >::const_iterator p = unit.definitions.begin(); p != unit.definitions.end(); ++p)
+    {
+        if (p->first < 0 || (size_t)p->first >= NUM_DEFINITION_LISTS) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void Mod::Unit::Replay(const GraphUnit& unit)
+{
+    cerr << unit.report;
+
+    for (vector<GraphObject>::const_iterator p = unit.objects.begin(); p != unit.objects.end(); ++p)
+    {
+        pair<ObjectList::iterator, bool> ins = (mod.*ObjectLists[p->list]).insert(make_pair(p->key, p->object));
+        if (!ins.second)
+        {
+            // Declared by an earlier unit
+            ModObject& object = ins.first->second;
+            object.m_name = p->object.m_name;
+            object.m_references.m_references.insert(object.m_references.m_references.end(), p->object.m_references.m_references.begin(), p->object.m_references.m_references.end());
+        }
+    }
+
+    for (vector<pair<int, string> >::const_iterator p = unit.definitions.begin(); p != unit.definitions.end(); ++p)
+    {
+        (mod.*DefinitionLists[p->first]).insert(p->second);
+    }
+
+    mod.m_globals.m_references.insert(mod.m_globals.m_references.end(), unit.globals.m_references.begin(), unit.globals.m_references.end());
+    if (mod.m_demand != NULL) {
+        mod.m_demand->m_references.insert(mod.m_demand->m_references.end(), unit.demands.m_references.begin(), unit.demands.m_references.end());
+    }
+}
+
+void Mod::Unit::Lookup(const ObjectList& objects, const string& key, bool insert, bool found)
+{
+    ObjectList::const_iterator object = objects.find(key);
+
+    GraphLookup lookup;
+    lookup.list       = GetIndex(mod, ObjectLists, objects);
+    lookup.definition = false;
+    lookup.insert     = insert;
+    lookup.key        = key;
+    lookup.found      = found;
+    if (found) {
+        lookup.location = object->second.m_location;
+    }
+    record.lookups.push_back(lookup);
+
+    if (insert)
+    {
+        // Keep the state of the first time the unit touches the object
+        Touched state = {!found, object->second.m_references.m_references.size(), object->second.m_name};
+        touched.insert(make_pair(make_pair(lookup.list, key), state));
+    }
+}
+
+void Mod::Unit::Define(const DefinitionList& definitions, const string& name, bool inserted)
+{
+    GraphLookup lookup;
+    lookup.list       = GetIndex(mod, DefinitionLists, definitions);
+    lookup.definition = true;
+    lookup.insert     = true;
+    lookup.key        = name;
+    lookup.found      = !inserted;
+    record.lookups.push_back(lookup);
+
+    if (inserted) {
+        record.definitions.push_back(make_pair(lookup.list, name));
+    }
+}
+
+Mod::Unit::Unit(Mod& mod, const string& kind, const Location& location, const string& name, const File* file)
+    : mod(mod), replayed(false), globals(0), demands(0)
+{
+    if (mod.m_graph == NULL || mod.m_unit != NULL) {
+        // Nothing to record, or part of the unit being recorded
+        return;
+    }
+
+    stringstream ss;
+    ss << kind << '|' << name << '|' << location.filename << ':' << location.line;
+    const int count = mod.m_keys[ss.str()]++;
+    if (count > 0) {
+        ss << '#' << count;
+    }
+    key = ss.str();
+
+    const GraphUnit* previous = mod.m_graph->find(key);
+    if (previous != NULL && IsCurrent(*previous, file))
+    {
+        Replay(*previous);
+        mod.m_graph->add(key, *previous);
+        replayed = true;
+        Stats::AddUnit(true);
+        return;
+    }
+    Stats::AddUnit(false);
+
+    if (file != NULL) {
+        record.dependencies.push_back(GraphDependency(Assets::ASSET_FILE, file->GetName(), file));
+    }
+    report.reset(new StreamCapture(cerr));
+    globals = mod.m_globals.m_references.size();
+    demands = (mod.m_demand != NULL) ? mod.m_demand->m_references.size() : 0;
+    mod.m_unit = this;
+}
+
+Mod::Unit::~Unit()
+{
+    if (mod.m_unit != this) {
+        return;
+    }
+    mod.m_unit = NULL;
+
+    if (uncaught_exception()) {
+        // The run fails; there's nothing to keep
+        return;
+    }
+
+    for (TouchedMap::const_iterator p = touched.begin(); p != touched.end(); ++p)
+    {
+        const ModObject& object = (mod.*ObjectLists[p->first.first]).find(p->first.second)->second;
+        if (p->second.created)
+        {
+            record.objects.push_back(GraphObject(p->first.first, p->first.second, object));
+        }
+        else if (object.m_references.m_references.size() != p->second.references || object.m_name != p->second.name)
+        {
+            list<Reference>::const_iterator start = object.m_references.m_references.begin();
+            advance(start, p->second.references);
+
+            ModObject added(object.m_location);
+            added.m_name = object.m_name;
+            added.m_references.m_references.assign(start, object.m_references.m_references.end());
+            record.objects.push_back(GraphObject(p->first.first, p->first.second, added));
+        }
+    }
+
+    list<Reference>::iterator start = mod.m_globals.m_references.begin();
+    advance(start, globals);
+    record.globals.m_references.assign(start, mod.m_globals.m_references.end());
+    if (mod.m_demand != NULL)
+    {
+        start = mod.m_demand->m_references.begin();
+        advance(start, demands);
+        record.demands.m_references.assign(start, mod.m_demand->m_references.end());
+    }
+
+    record.report = report->str();
+    mod.m_graph->add(key, record);
+}
+
+pair<ObjectList::iterator, bool> Mod::InsertObject(ObjectList& objects, const string& key, const ModObject& object)
+{
+    pair<ObjectList::iterator, bool> ins = objects.insert(make_pair(key, object));
+    if (m_unit != NULL) {
+        m_unit->Lookup(objects, key, true, !ins.second);
+    }
+    return ins;
+}
+
+bool Mod::IsDeclared(const ObjectList& objects, const string& key)
+{
+    const bool found = (objects.find(key) != objects.end());
+    if (m_unit != NULL) {
+        m_unit->Lookup(objects, key, false, found);
+    }
+    return found;
+}
+
+bool Mod::InsertDefinition(DefinitionList& definitions, const string& name)
+{
+    const bool inserted = definitions.insert(name);
+    if (m_unit != NULL) {
+        m_unit->Define(definitions, name, inserted);
+    }
+    return inserted;
+}
+
+ptr<File> Mod::LoadAsset(const Reference& ref, bool error)
+{
+    const Assets::AssetType type = GetAssetType(ref.id.type);
+    ptr<File> f = Assets::Load(type, ref.id.name);
+    if (m_unit != NULL) {
+        m_unit->record.dependencies.push_back(GraphDependency(type, ref.id.name, f));
+    }
+    if (f == NULL && error)
+    {
+        unknown(ref.location, GetObjTypeName(ref.id.type), ref.id.name);
+    }
+    return f;
+}
+
+void ReferenceList::add(const Location& location, const std::string& value, const TagPattern& pattern, const char* prefix)
 {
     add(location, value.c_str(), pattern, prefix);
 }
 
-void ReferenceList::add(const Location& location, const char* value, const char* pattern, const char* prefix)
+void ReferenceList::add(const Location& location, const char* value, const TagPattern& tp, const char* prefix)
 {
     // Attempt to match the pattern
-    const char *loop = NULL, *s = pattern;
-    bool single = (strlen(pattern) == 1);
-    
+    size_t index = 0;
+
     // Loop over all tokens in data
-    for (const char *d = value; *d != '\0'; ++s)
+    for (const char *d = value; *d != '\0';)
     {
         // Find the start of the first token
-        while (isspace(*d)) d++;
-        if (*d != '\0')
-        {
-            // Find the end of the token
-            const char* end;
-            if (single) {
-                // Single value; trim right-side of entire string
-                for (end = d + strlen(d); end > d && isspace(*(end-1)); end--);
-            } else {
-                // Multiple values, find the end of the identifier
-                for (end = d; isident(*end); end++);
-            }
-            string value(d, end - d);
+        d = Tokenizer::SkipSpace(d);
+        if (*d == '\0')
+        {
+            break;
+        }
 
-            while (*s == ')') {
-                // Move back to loop start
-                assert(loop != NULL);
-                s = loop;
-                loop = NULL;
-            }
-            while (*s == '(') {
-                // Set loop start
-                assert(loop == NULL);
-                loop = s++;
-            }
+        // Find the end of the token
+        const char* end;
+        if (tp.single) {
+            // Single value; trim right-side of entire string
+            for (end = d + strlen(d); end > d && Tokenizer::IsSpace(*(end-1)); end--);
+        } else {
+            // Multiple values, find the end of the identifier
+            end = Tokenizer::SkipIdent(d);
+        }
 
-            if (*s == '\0') {
-                error(location, "unexpected value: \"" + value + "\"");
+        if (index == tp.types.size()) {
+            if (tp.loop == tp.types.size()) {
+                error(location, "unexpected value: \"" + string(d, end - d) + "\"");
                 break;
             }
+            // Move back to loop start
+            index = tp.loop;
+        }
+        const ObjType type = tp.types[index++];
 
-            if (!value.empty())
-            {
-                if (!IsObjOfType(value, *s)) {
-                    error(location, "expected " + string(GetObjTypeName(*s)) + " as value");
-                } else {
-                    if (prefix != NULL) {
-                        // Prefix value to form reference
-                        value = prefix + value;
-                    }
-                    m_references.push_back(Reference(ObjectID(*s, value), location));
-                }
+        if (end > d)
+        {
+            if (!IsObjOfType(d, end - d, type)) {
+                error(location, "expected " + string(GetObjTypeName(type)) + " as value");
+            } else {
+                // Prefix value to form reference
+                string name(prefix != NULL ? prefix : "");
+                name.append(d, end - d);
+                m_references.push_back(Reference(ObjectID(type, name), location));
             }
+        }
 
-            d = end;
-            if (*end != '\0')
-            {
-                // Find separator after identifier
-                const char* sep = end;
-                while (isspace(*sep)) sep++;
-                d = (!isident(*sep) ? sep : end) + 1;
-            }
+        d = end;
+        if (*end != '\0')
+        {
+            // Find separator after identifier
+            const char* sep = Tokenizer::SkipSpace(end);
+            d = (*sep == '\0') ? sep : (!Tokenizer::IsIdent(*sep) ? sep : end) + 1;
         }
     }
 }
@@ -226,7 +643,7 @@ bool ReferenceList::add(const XMLNode& node, const Tags& tags)
     }
     else if (ti->pattern != NULL && data != NULL)
     {
-        add(node, data, ti->pattern, ti->prefix);
+        add(node, data, ti->compiled, ti->prefix);
     }
     return true;
 }
@@ -301,33 +718,33 @@ void Mod::ParseMap(const Location& location, const Assets::Map& map)
     const Assets::Map::Properties& properties = map.GetProperties();
     if (properties.m_name.compare(0, 5, L"TEXT_") == 0) {
         // The name starts with TEXT_, so it's probably a text string reference
-        m_demand->add(location, Utils::ConvertWideStringToAnsiString(properties.m_name), "s");
+        m_demand->add(location, Utils::ConvertWideStringToAnsiString(properties.m_name), Pattern_String);
     }
 
     for (size_t i = 0; i < 3; i++) {
-        m_demand->add(location, map.GetWater().maps[i], "t");
+        m_demand->add(location, map.GetWater().maps[i], Pattern_Texture);
     }
     
     const vector<Assets::Map::Environment>& environments = map.GetEnvironments();
     for (size_t i = 0; i < environments.size(); i++)
     {
-        m_demand->add(location, environments[i].m_clouds,   "t");
-        m_demand->add(location, environments[i].m_skybox1,  "G");
-        m_demand->add(location, environments[i].m_skybox2,  "G");
-        m_demand->add(location, environments[i].m_scenario, "K");
+        m_demand->add(location, environments[i].m_clouds,   Pattern_Texture);
+        m_demand->add(location, environments[i].m_skybox1,  Pattern_GameObject);
+        m_demand->add(location, environments[i].m_skybox2,  Pattern_GameObject);
+        m_demand->add(location, environments[i].m_scenario, Pattern_WeatherScenario);
     }
 
     const vector<Assets::Map::Layer>& layers = map.GetLayers();
     for (size_t i = 0; i < layers.size(); i++)
     {
-        m_demand->add(location, layers[i].colorTexture,  "t");
-        m_demand->add(location, layers[i].normalTexture, "t");
+        m_demand->add(location, layers[i].colorTexture,  Pattern_Texture);
+        m_demand->add(location, layers[i].normalTexture, Pattern_Texture);
     }
 
     const vector<Assets::Map::Track>& tracks = map.GetTracks();
     for (size_t i = 0; i < tracks.size(); i++)
     {
-        m_demand->add(location, tracks[i].m_texture, "t");
+        m_demand->add(location, tracks[i].m_texture, Pattern_Texture);
     }
 
     set<unsigned long> crcs;
@@ -342,9 +759,31 @@ void Mod::ParseMap(const Location& location, const Assets::Map& map)
 
     for (set<unsigned long>::const_iterator c = crcs.begin(); c != crcs.end(); ++c)
     {
-        stringstream ss;
-        ss << *c;
-        m_demand->add(Reference(ObjectID(OBJ_GAME_OBJECT_CRC, ss.str()), location));
+        m_demand->add(Reference(ObjectID(OBJ_GAME_OBJECT_CRC, *c), location));
+    }
+}
+
+// Adds a multiplayer map to the global references
+void Mod::ParseMapHeader(const Location& location, const string& filename)
+{
+    Unit unit(*this, "ParseMapHeader", location, filename);
+    if (unit.replayed) {
+        return;
+    }
+
+    ptr<File> f = LoadAsset(Reference(ObjectID(OBJ_MAP, filename), Location("<root>")));
+    if (f != NULL) try
+    {
+        string      map_name = Utils::GetFilename(f->GetName());
+        Assets::Map map(*f, Assets::MAP_PROPERTIES);
+        if (map.GetProperties().m_numPlayers > 1) {
+            // It's a multiplayer map, add it to the global references
+            m_globals.add(Reference(ObjectID(OBJ_MAP, map_name), location));
+        }
+    }
+    catch (BadFileException&)
+    {
+        error(location, "Bad map file: " + f->GetName());
     }
 }
 
@@ -368,10 +807,9 @@ void Mod::ParseCampaign(const XMLNode& node, ModObject& object, const Tags& tags
     return ParseReferences(node, object, tags);
 }
 
-void Mod::ParseModel(const Location& location, Assets::Model& model)
+// Gets the files that a model refers to
+static void GetDependencies(Assets::Model& model, ModelDependencies& deps)
 {
-    set<string> shaders, textures, particles;
-    
     for (size_t i = 0; i < model.GetNumMaterials(); i++)
     {
         const Assets::Model::Material& material = model.GetMaterial(i);
@@ -379,14 +817,14 @@ void Mod::ParseModel(const Location& location, Assets::Model& model)
             _stricmp(material.m_name.c_str(), "default.fx") != 0)
         {
             // Don't check for alDefault.fx and Default.fx
-            shaders.insert(material.m_name);
+            deps.shaders.insert(material.m_name);
         }
 
         for (size_t j = 0; j < material.m_parameters.size(); j++)
         {
             if (material.m_parameters[j].m_type == PARAM_TEXTURE)
             {
-                textures.insert(material.m_parameters[j].m_texture);
+                deps.textures.insert(material.m_parameters[j].m_texture);
             }
         }
     }
@@ -394,257 +832,218 @@ void Mod::ParseModel(const Location& location, Assets::Model& model)
     for (size_t i = 0; i < model.GetNumProxies(); i++)
     {
         const Assets::Model::Proxy& proxy = model.GetProxy(i);
-        particles.insert(proxy.m_name);
+        deps.particles.insert(proxy.m_name);
     }
+}
 
-    for (set<string>::const_iterator p = shaders  .begin(); p != shaders  .end(); ++p) m_demand->add(Reference(ObjectID(OBJ_SHADER,   *p), location));
-    for (set<string>::const_iterator p = textures .begin(); p != textures .end(); ++p) m_demand->add(Reference(ObjectID(OBJ_TEXTURE,  *p), location));
-    for (set<string>::const_iterator p = particles.begin(); p != particles.end(); ++p) m_demand->add(Reference(ObjectID(OBJ_PARTICLE, *p), location));
+// Gets the name of a particle system and the files it refers to
+static void GetDependencies(Assets::ParticleSystem& particle, ModelDependencies& deps)
+{
+    deps.name = particle.GetName();
+    for (size_t i = 0; i < particle.GetNumEmitters(); i++)
+    {
+        const Assets::ParticleSystem::Emitter& emitter = particle.GetEmitter(i);
+        deps.textures.insert(Utils::GetFilename(emitter.normalTexture));
+        deps.textures.insert(Utils::GetFilename(emitter.colorTexture));
+    }
+}
+
+void Mod::ParseModel(const Location& location, const ModelDependencies& deps)
+{
+    for (set<string>::const_iterator p = deps.shaders  .begin(); p != deps.shaders  .end(); ++p) m_demand->add(Reference(ObjectID(OBJ_SHADER,   *p), location));
+    for (set<string>::const_iterator p = deps.textures .begin(); p != deps.textures .end(); ++p) m_demand->add(Reference(ObjectID(OBJ_TEXTURE,  *p), location));
+    for (set<string>::const_iterator p = deps.particles.begin(); p != deps.particles.end(); ++p) m_demand->add(Reference(ObjectID(OBJ_PARTICLE, *p), location));
 }
 
-void Mod::ParseParticle(const Location& location, Assets::ParticleSystem& particle)
+void Mod::ParseParticle(const Location& location, const ModelDependencies& deps)
 {
     string filename = Utils::GetFilename(location.filename);
     string::size_type ext = filename.find_last_of(".");
     if (ext != string::npos) filename.erase(ext);
-    if (_stricmp(filename.c_str(), particle.GetName().c_str()) != 0)
+    if (_stricmp(filename.c_str(), deps.name.c_str()) != 0)
     {
-        error(location, "particle's internal name does not match its filename: " + location.filename + ";" + filename + ";" + particle.GetName());
-    }
-    
-    set<string> textures;
-    for (size_t i = 0; i < particle.GetNumEmitters(); i++)
-    {
-        const Assets::ParticleSystem::Emitter& emitter = particle.GetEmitter(i);
-        textures.insert(Utils::GetFilename(emitter.normalTexture));
-        textures.insert(Utils::GetFilename(emitter.colorTexture));
+        error(location, "particle's internal name does not match its filename: " + location.filename + ";" + filename + ";" + deps.name);
     }
 
-    for (set<string>::const_iterator p = textures .begin(); p != textures .end(); ++p)
+    for (set<string>::const_iterator p = deps.textures .begin(); p != deps.textures .end(); ++p)
     {
         m_demand->add(Reference(ObjectID(OBJ_TEXTURE,  *p), location));
     }
 }
 
-void Mod::CheckMap(const Reference& reference, File& f)
+// Returns the key of a model or particle file in the model cache, if there is one
+ModelCache::Key Mod::GetModelKey(File& f) const
 {
-    try
-    {
-        Assets::Map map(f);
-        ParseMap(Location(f.GetName()), map);
-    }
-    catch (BadFileException&)
-    {
-        error(reference.location, "Bad map file: " + f.GetName());
+    if (m_models != NULL) {
+        return ModelCache::GetKey(f);
     }
+    ModelCache::Key key = {0, 0};
+    return key;
 }
 
-void Mod::CheckModel(const Reference& reference, File& f)
+// Reads the file as the specified type, or takes its dependencies from the
+// model cache if it has been read before. Returns false if it's a bad file.
+bool Mod::ReadDependencies(File& f, const ModelCache::Key& key, ModelCache::Type type, ModelDependencies& deps)
 {
-    try
+    const ModelDependencies* cached = (m_models != NULL) ? m_models->find(key, type) : NULL;
+    if (cached != NULL)
     {
-        Assets::Model model(f);
-        ParseModel(Location(f.GetName()), model);
+        deps = *cached;
+        return deps.valid;
     }
-    catch (BadFileException&)
-    {
-        error(reference.location, "Bad model file: " + f.GetName());
-    }
-}
 
-void Mod::CheckModelOrParticle(const Reference& reference, File& f)
-{
-    Location location(f.GetName());
+    deps = ModelDependencies();
     try
     {
-        Assets::Model model(f);
-        ParseModel(location, model);
+        if (type == ModelCache::MODEL) {
+            Assets::Model model(f);
+            GetDependencies(model, deps);
+        } else {
+            Assets::ParticleSystem particle(f);
+            GetDependencies(particle, deps);
+        }
+        deps.valid = true;
     }
     catch (BadFileException&)
     {
-        try
-        {
-            Assets::ParticleSystem particle(f);
-            ParseParticle(location, particle);
-        }
-        catch (BadFileException&)
-        {
-           error(reference.location, "Bad model or particle file: " + f.GetName());
-        }
+        deps = ModelDependencies();
     }
+
+    if (m_models != NULL) {
+        m_models->add(key, type, deps);
+    }
+    return deps.valid;
 }
 
-void Mod::CheckParticle(const Reference& reference, File& f)
+void Mod::CheckMap(const Reference& reference, File& f)
 {
     try
     {
-        Assets::ParticleSystem particle(f);
-        ParseParticle(Location(f.GetName()), particle);
+        // ParseMap() uses every section, including the terrain's textures
+        Assets::Map map(f, Assets::MAP_ALL);
+        ParseMap(Location(f.GetName()), map);
     }
     catch (BadFileException&)
     {
-        error(reference.location, "Bad model or particle file: " + f.GetName());
+        error(reference.location, "Bad map file: " + f.GetName());
     }
 }
 
-struct LuaLoadInfo
-{
-    static const size_t BUFFER_SIZE = 32*1024;
-
-    File* f;
-    char  buffer[BUFFER_SIZE];
-};
-
-static const char * LuaFileReader(lua_State *s, void *data, size_t *size)
+void Mod::CheckModel(const Reference& reference, File& f)
 {
-    LuaLoadInfo* lli = (LuaLoadInfo*)data;
-    *size = 0;
-    if (!lli->f->IsEOF()) try {
-        *size = lli->f->Read(lli->buffer, LuaLoadInfo::BUFFER_SIZE);
-    } catch (IOException&) {
+    ModelDependencies deps;
+    if (ReadDependencies(f, GetModelKey(f), ModelCache::MODEL, deps)) {
+        ParseModel(Location(f.GetName()), deps);
+    } else {
+        error(reference.location, "Bad model file: " + f.GetName());
     }
-    return (*size > 0) ? lli->buffer : NULL;
 }
 
-static void lua_error(const string& filename, lua_State* L)
+void Mod::CheckModelOrParticle(const Reference& reference, File& f)
 {
-    int line = -1;
-    const char* lua_error = lua_tostring(L, -1);
-    const char* col = strchr(lua_error, ':');
-    if (col++ != NULL) {
-        sscanf(col, "%d", &line);
-        // Advance past the next ": " to get the actual error message
-        if ((col = strchr(col, ':'))++ != NULL) {
-            lua_error = isspace(*col) ? col + 1 : col;
-        }
+    // A particle system starts with chunk 0x900, a model with its skeleton.
+    // Only read the file as the type it claims to be, so a particle system
+    // isn't read as model first, only to fail on its first chunk.
+    const ModelCache::Type type = (Assets::PeekChunkType(f) == 0x900) ? ModelCache::PARTICLE : ModelCache::MODEL;
+
+    Location location(f.GetName());
+    ModelDependencies deps;
+    if (!ReadDependencies(f, GetModelKey(f), type, deps)) {
+        error(reference.location, "Bad model or particle file: " + f.GetName());
+    } else if (type == ModelCache::MODEL) {
+        ParseModel(location, deps);
+    } else {
+        ParseParticle(location, deps);
     }
-    // We take our own filename, and append Lua's error message
-    error(Location(filename, line), lua_error);
 }
 
-struct LuaInfo
+void Mod::CheckParticle(const Reference& reference, File& f)
 {
-    Mod*    mod;
-    string* basepath;
-    File*   f;
-};
-
-// A dummy function that will be called for every operation on
-// every object in a Lua script. This way we can execute Lua scripts
-// and extract specific meaningful data without having to implement
-// every single type and function from the game.
-static int Lua_Dummy(lua_State *L)
-{
-    static const char* MetaMethods[] = {
-        "__add",
-        "__sub",
-        "__mul",
-        "__div",
-        "__pow",
-        "__unm",
-        "__concat",
-        "__eq",
-        "__lt",
-        "__le",
-        "__index",
-        //"__newindex", // Not this one, we do want to be able to regularly set values
-        "__call",
-        NULL
-    };
-
-    // Whatever we request, we return a dummy table with all metamethods 
-    // set to return another dummy table.
-    lua_newtable(L);   
-    lua_newtable(L);
-    for (size_t i = 0; MetaMethods[i] != NULL; i++)
-    {
-        lua_pushstring(L, MetaMethods[i]);
-        lua_pushcfunction(L, Lua_Dummy);
-        lua_settable(L, -3);
+    ModelDependencies deps;
+    if (ReadDependencies(f, GetModelKey(f), ModelCache::PARTICLE, deps)) {
+        ParseParticle(Location(f.GetName()), deps);
+    } else {
+        error(reference.location, "Bad model or particle file: " + f.GetName());
     }
-    lua_setmetatable(L, -2);
-    return 1;
 }
 
-int Mod::Lua_Require(lua_State *L)
+// A script to check on the thread pool. The source is read on the main
+// thread; the results are reported by FlushScripts(), in queued order.
+struct Mod::ScriptJob : public Job, public Object
 {
-    if (lua_gettop(L) > 0 && lua_isstring(L, -1))
-    {
-        int idx = lua_upvalueindex(1);
-        assert(lua_islightuserdata(L, idx));
-        const LuaInfo* info = (const LuaInfo*)lua_touserdata(L, idx);
-
-        Location location(info->f->GetName());
-        const char* include = lua_tostring(L, -1);
+    Mod&           mod;
+    std::string    name;
+    std::string    filename;
+    vector<char>   source;
+    bool           ai;
+    std::string    category;      // For AI scripts
+    DiagnosticList diagnostics;
+    ScriptReferenceList references;
 
-        ptr<File> f;
-        string filename;
-        if ((f = Assets::LoadScript(filename = (*info->basepath + include))) == NULL) {
-            f = Assets::LoadScript(filename = (string("Library\\") + include));
-        }
-
-        if (f == NULL) {
-            unknown(location, "script library", filename);
+    void Run(size_t worker)
+    {
+        ScriptChecker& checker = *mod.m_checkers[worker];
+        if (ai) {
+            category = checker.CheckAIScript(name, filename, source, diagnostics, references);
         } else {
-            info->mod->CheckScript(Reference(ObjectID(OBJ_SCRIPT, filename), location), *f);
+            checker.CheckScript(name, filename, source, diagnostics, references);
         }
     }
-    return 0;
-}
 
-static lua_State* LoadScript(File& f)
+    ScriptJob(Mod& mod, const std::string& name, File& f, bool ai)
+        : mod(mod), name(name), filename(f.GetName()), ai(ai)
+    {
+        ScriptChecker::ReadSource(f, source);
+    }
+};
+
+void Mod::QueueScript(const string& name, File& f, bool ai)
 {
-    lua_State* s = lua_open();
-    LuaLoadInfo info = {&f};
+    ptr<ScriptJob> job = new ScriptJob(*this, name, f, ai);
+    m_scriptJobs.push_back(job);
+    m_threads.add(job);
+}
 
-    if (lua_load(s, LuaFileReader, &info, Utils::GetFilename(f.GetName()).c_str()) != 0)
+void Mod::FlushScripts()
+{
+    m_threads.wait();
+    for (vector<ptr<ScriptJob> >::const_iterator p = m_scriptJobs.begin(); p != m_scriptJobs.end(); ++p)
     {
-        // Get and print error
-        if (lua_isstring(s, -1))
+        const ScriptJob& job = **p;
+        for (DiagnosticList::const_iterator d = job.diagnostics.begin(); d != job.diagnostics.end(); ++d)
         {
-            // Find the line part of the error (ignore the filename part)
-            lua_error(f.GetName(), s);
+            error(d->location, d->message);
         }
-        else
+
+        // Add the references of scripts that no earlier job reported.
+        // Each checker reports a library once, but libraries are shared between checkers.
+        ReferenceList& references = (m_demand != NULL) ? *m_demand : m_globals;
+        map<string, bool> files;
+        for (ScriptReferenceList::const_iterator r = job.references.begin(); r != job.references.end(); ++r)
         {
-            error(Location(f.GetName()), "unknown Lua error");
+            const string key = Utils::Uppercase(r->location.filename);
+            map<string, bool>::iterator f = files.find(key);
+            if (f == files.end()) {
+                f = files.insert(make_pair(key, m_scriptFiles.insert(key).second)).first;
+            }
+
+            if (f->second) {
+                references.add(r->location, r->value, *r->pattern);
+            }
         }
-        lua_close(s);
-        return NULL;
-    }
 
-    // Override the __index event in the global's metatable
-    if (lua_getmetatable(s, LUA_GLOBALSINDEX) == 0)
-    {
-        lua_newtable(s);
+        if (job.ai && !job.category.empty())
+        {
+            // Get the list of goals
+            m_globals.add(Location(job.name), job.category, Pattern_Goals);
+        }
     }
-    lua_pushstring(s, "__index");
-    lua_pushcfunction(s, Lua_Dummy);
-    lua_settable(s, -3);
-    lua_setmetatable(s, LUA_GLOBALSINDEX);
-    return s;
+    m_scriptJobs.clear();
 }
 
 void Mod::CheckScript(const Reference& reference, File& f)
 {
-    lua_State* s = LoadScript(f);
-    if (s != NULL)
-    {
-        // Execute top-level chunk to resolve requires.
-        string basepath = Utils::GetBasePath(reference.id.name);
-        LuaInfo info = {this, &basepath, &f};
-
-        lua_pushstring(s, "require");
-        lua_pushlightuserdata(s, &info);
-        lua_pushcclosure(s, Lua_Require, 1);
-        lua_settable(s, LUA_GLOBALSINDEX);
-
-        if (lua_pcall(s, 0, 0, 0) != 0)
-        {
-            lua_error(f.GetName(), s);
-        }
-        lua_close(s);
-    }
+    QueueScript(reference.id.name, f, false);
 }
 
 void Mod::ParseAIScript(const Location &location, const string &filename)
@@ -652,45 +1051,7 @@ void Mod::ParseAIScript(const Location &location, const string &filename)
     ptr<File> f = LoadAsset(Reference(ObjectID(OBJ_SCRIPT, filename), location));
     if (f != NULL)
     {
-        lua_State* s = LoadScript(*f);
-        if (s != NULL)
-        {
-            // Execute top-level chunk to resolve requires.
-            string basepath = Utils::GetBasePath(filename);
-            LuaInfo info = {this, &basepath, f};
-
-            lua_pushstring(s, "require");
-            lua_pushlightuserdata(s, &info);
-            lua_pushcclosure(s, Lua_Require, 1);
-            lua_settable(s, LUA_GLOBALSINDEX);
-
-            if (lua_pcall(s, 0, 0, 0) != 0)
-            {
-                lua_error(filename, s);
-            }
-            else
-            {
-                // Execute the "Definitions" function to establish the Category
-                lua_pushstring(s, "Definitions");
-                lua_gettable(s, LUA_GLOBALSINDEX);
-                if (lua_pcall(s, 0, 0, 0) != 0)
-                {
-                    lua_error(filename, s);
-                }
-                else
-                {
-                    // Get the category
-                    lua_pushstring(s, "Category");
-                    lua_gettable(s, LUA_GLOBALSINDEX);
-                    if (lua_isstring(s, -1))
-                    {
-                        // Get the list of goals
-                        m_globals.add(Location(filename), lua_tostring(s,-1), "(!)");
-                    }
-                }
-            }
-            lua_close(s);
-        }
+        QueueScript(filename, *f, true);
     }
 }
 
@@ -809,7 +1170,7 @@ void Mod::ParseGoalSet(const Reference& reference, File& f)
         for (XMLNode::const_iterator p = root.begin(); p != root.end(); ++p)
         {
             string id(Utils::Uppercase(p->GetName()));
-            pair<ObjectList::iterator, bool> ins = m_goalSets.insert(make_pair(id, ModObject(*p)));
+            pair<ObjectList::iterator, bool> ins = InsertObject(m_goalSets, id, ModObject(*p));
             if (!ins.second)
             {
                 if (ins.first->second.m_location != *p)
@@ -844,7 +1205,7 @@ void Mod::ParseGoalSet(const Reference& reference, File& f)
 ModObject* Mod::ParseGoal(const XMLNode& node, const char* type, ObjectList& objects, const Tags& tags, const ObjectCallback& callback, bool allow_duplicates)
 {
     string id = Utils::Uppercase(node.GetName());
-    pair<ObjectList::iterator, bool> r = objects.insert(make_pair(id, ModObject(node)));
+    pair<ObjectList::iterator, bool> r = InsertObject(objects, id, ModObject(node));
     ModObject& object = r.first->second;
     if (!allow_duplicates && !r.second)
     {
@@ -863,7 +1224,7 @@ ModObject* Mod::ParseGoal(const XMLNode& node, const char* type, ObjectList& obj
 ModObject* Mod::ParseTemplate(const XMLNode& node, const char* type, ObjectList& objects, const Tags& tags, const ObjectCallback& callback, bool allow_duplicates)
 {
     string id = Utils::Uppercase(node.GetName());
-    pair<ObjectList::iterator, bool> r = objects.insert(make_pair(id, ModObject(node)));
+    pair<ObjectList::iterator, bool> r = InsertObject(objects, id, ModObject(node));
     ModObject& object = r.first->second;
     if (!allow_duplicates && !r.second)
     {
@@ -924,7 +1285,7 @@ ModObject* Mod::ParseTemplate(const XMLNode& node, const char* type, ObjectList&
 ModObject* Mod::ParseEquation(const XMLNode& node, const char* type, ObjectList& objects, const Tags& tags, const ObjectCallback& callback, bool allow_duplicates)
 {
     string id = Utils::Uppercase(node.GetName());
-    pair<ObjectList::iterator, bool> r = objects.insert(make_pair(id, ModObject(node)));
+    pair<ObjectList::iterator, bool> r = InsertObject(objects, id, ModObject(node));
     ModObject& object = r.first->second;
     if (!allow_duplicates && !r.second)
     {
@@ -964,6 +1325,11 @@ ModObject* Mod::ParseEquation(const XMLNode& node, const char* type, ObjectList&
 
 void Mod::ParseAIPlayer(const Location& location, const string& filename)
 {
+    Unit unit(*this, "ParseAIPlayer", location, filename);
+    if (unit.replayed) {
+        return;
+    }
+
     ptr<File> f = LoadAsset(Reference(ObjectID(OBJ_XML, filename), location));
     if (f != NULL) try
     {
@@ -1030,7 +1396,7 @@ void Mod::ParseAIPlayer(const Location& location, const string& filename)
         }
 
         string id = Utils::Uppercase(object.m_name);
-        pair<ObjectList::iterator, bool> ins = m_aiPlayers.insert(make_pair(id, object));
+        pair<ObjectList::iterator, bool> ins = InsertObject(m_aiPlayers, id, object);
         if (!ins.second)
         {
             duplicate(root, "AI player", object.m_name, ins.first->second.m_location);
@@ -1066,11 +1432,13 @@ void Mod::ParseGameObject(const XMLNode& node, ModObject& object, const Tags& ta
         const char* data = node.GetData();
         if (data != NULL)
         {
-            vector<string> ids = Utils::Split(data, ",");
-            for (vector<string>::const_iterator p = ids.begin(); p != ids.end(); ++p)
+            vector<Tokenizer::Token> ids;
+            Tokenizer::Split(data, ',', ids);
+            for (vector<Tokenizer::Token>::const_iterator p = ids.begin(); p != ids.end(); ++p)
             {
-                const string key = Utils::Trim(Utils::Uppercase(*p));
-                if (m_factions.find(key) == m_factions.end())
+                string key = p->str();
+                transform(key.begin(), key.end(), key.begin(), toupper);
+                if (!IsDeclared(m_factions, key))
                 {
                     // Not a faction? Assume it's a GameObject reference
                     object.m_references.m_references.push_back(Reference(ObjectID(OBJ_GAME_OBJECT, key), node));
@@ -1116,9 +1484,9 @@ void Mod::ParseGameObject(const XMLNode& node, ModObject& object, const Tags& ta
                     } else if (q->Equals("Type")) {
                         CheckBuiltin(Reference(ObjectID(OBJ_ABILITY_TYPE, q->GetData()), *q), Builtins::AbilityTypes, m_game);
                     } else if (q->Equals("Alternate_Description_Text")) {
-                        object.m_references.add(*q, q->GetData(), "(s)");
+                        object.m_references.add(*q, q->GetData(), Pattern_Strings);
                     } else if (q->Equals("SFXEvent_GUI_Unit_Ability_Activated")) {
-                        object.m_references.add(*q, q->GetData(), "X");
+                        object.m_references.add(*q, q->GetData(), Pattern_SFXEvent);
                     }
                 }
             }
@@ -1126,7 +1494,7 @@ void Mod::ParseGameObject(const XMLNode& node, ModObject& object, const Tags& ta
             if (!ability.m_name.empty())
             {
                 // Ignore duplicates
-                m_abilities.insert(make_pair(Utils::Uppercase(ability.m_name), ability));
+                InsertObject(m_abilities, Utils::Uppercase(ability.m_name), ability);
             }
         }
         return;
@@ -1147,7 +1515,7 @@ ModObject* Mod::ParseObject(const XMLNode& node, const char* type, ObjectList& o
     }
 
     string id = Utils::Uppercase(name);
-    pair<ObjectList::iterator, bool> r = objects.insert(make_pair(id, ModObject(node)));
+    pair<ObjectList::iterator, bool> r = InsertObject(objects, id, ModObject(node));
     ModObject& object = r.first->second;
     if (!allow_duplicates && !r.second)
     {
@@ -1173,6 +1541,12 @@ void Mod::ParseObjects(const XMLNode& node, const char* type, ObjectList& object
 
 void Mod::ParseFile(const Location& loc, const char* filename, const char* type, ObjectList& objects, const Tags& tags, const FileCallback& callback, const ObjectCallback& ocallback)
 {
+    Stats::Timer timer(filename);
+    Unit unit(*this, string("ParseFile:") + type, loc, filename);
+    if (unit.replayed) {
+        return;
+    }
+
     ptr<File> f;
     if ((f = LoadAsset(Reference(ObjectID(OBJ_XML, filename), loc))) != NULL)
     {
@@ -1191,6 +1565,7 @@ void Mod::ParseFile(const Location& loc, const char* filename, const char* type,
 
 void Mod::ParseIndexFile(const Location& loc, const char* filename, const char* type, ObjectList& objects, const Tags& tags, const FileCallback& callback, const ObjectCallback& ocallback)
 {
+    Stats::Timer timer(filename);
     ptr<File> f;
     if ((f = LoadAsset(Reference(ObjectID(OBJ_XML, filename), loc))) != NULL)
     {
@@ -1216,6 +1591,11 @@ void Mod::ParseIndexFile(const Location& loc, const char* filename, const char*
 
 void Mod::ParseRadarMap(const Location& loc, const char* filename)
 {
+    Unit unit(*this, "ParseRadarMap", loc, filename);
+    if (unit.replayed) {
+        return;
+    }
+
     ptr<File> f;
     if ((f = LoadAsset(Reference(ObjectID(OBJ_XML, filename), loc))) != NULL)
     {
@@ -1262,6 +1642,11 @@ void Mod::ParseTradeRouteLine(const XMLNode& node, ModObject& object, const Tags
 
 void Mod::ParseWeatherAudio(const Location& loc, const char* filename)
 {
+    Unit unit(*this, "ParseWeatherAudio", loc, filename);
+    if (unit.replayed) {
+        return;
+    }
+
     ptr<File> f;
     if ((f = LoadAsset(Reference(ObjectID(OBJ_XML, filename), loc))) != NULL)
     {
@@ -1348,6 +1733,11 @@ ModObject* Mod::ParseWeatherModifier(const XMLNode& node, const char* type, Obje
 
 void Mod::ParseAnimationSFXMaps(const Location& location, const char* filename)
 {
+    Unit unit(*this, "ParseAnimationSFXMaps", location, filename);
+    if (unit.replayed) {
+        return;
+    }
+
     ptr<File> f = LoadAsset(Reference(ObjectID(OBJ_FILE, filename), location));
     if (f != NULL && f->GetSize() > 0)
     {
@@ -1383,6 +1773,11 @@ void Mod::ParseAnimationSFXMaps(const Location& location, const char* filename)
 
 void Mod::ParseGameConstants(const Location& location, const char* filename)
 {
+    Unit unit(*this, "ParseGameConstants", location, filename);
+    if (unit.replayed) {
+        return;
+    }
+
     ptr<File> f;
     if ((f = LoadAsset(Reference(ObjectID(OBJ_XML, filename), location))) != NULL)
     {
@@ -1407,7 +1802,7 @@ void Mod::ParseGameConstants(const Location& location, const char* filename)
                         for (vector<string>::iterator t = types.begin(); t != types.end(); ++t)
                         {
                             transform(t->begin(), t->end(), t->begin(), toupper);
-                            if (!m_damageTypes.insert(Utils::Trim(*t)).second) {
+                            if (!InsertDefinition(m_damageTypes, Utils::Trim(*t))) {
                                 error(*p, "duplicate damage type");
                             }
                         }
@@ -1425,7 +1820,7 @@ void Mod::ParseGameConstants(const Location& location, const char* filename)
                         for (vector<string>::iterator t = types.begin(); t != types.end(); ++t)
                         {
                             transform(t->begin(), t->end(), t->begin(), toupper);
-                            if (!m_armorTypes.insert(Utils::Trim(*t)).second) {
+                            if (!InsertDefinition(m_armorTypes, Utils::Trim(*t))) {
                                 error(*p, "duplicate armor type");
                             }
                         }
@@ -1447,6 +1842,11 @@ void Mod::ParseGameConstants(const Location& location, const char* filename)
 
 void Mod::ParseAudio(const Location& location, const char* filename)
 {
+    Unit unit(*this, "ParseAudio", location, filename);
+    if (unit.replayed) {
+        return;
+    }
+
     ptr<File> f;
     if ((f = LoadAsset(Reference(ObjectID(OBJ_XML, filename), location))) != NULL)
     {
@@ -1468,6 +1868,11 @@ void Mod::ParseAudio(const Location& location, const char* filename)
 
 void Mod::ParseEnumeration(const Location& location, const char* filename, const string& type, DefinitionList& definitions)
 {
+    Unit unit(*this, "ParseEnumeration:" + type, location, filename);
+    if (unit.replayed) {
+        return;
+    }
+
     ptr<File> f;
     if ((f = LoadAsset(Reference(ObjectID(OBJ_XML, filename), location))) != NULL)
     {
@@ -1487,7 +1892,7 @@ void Mod::ParseEnumeration(const Location& location, const char* filename, const
                     string value(data);
                     if (!IsObjOfType(value, OBJ_INTEGER)) {
                         error(*p, "expected integer value");
-                    } else if (!definitions.insert(Utils::Uppercase(p->GetName())).second) {
+                    } else if (!InsertDefinition(definitions, p->GetName())) {
                         error(*p, "duplicate " + type);
                     }
                 }
@@ -1500,17 +1905,29 @@ void Mod::ParseEnumeration(const Location& location, const char* filename, const
     }
 }
 
-void Mod::LoadReferenceObjects(ChecksumMap& checksums)
+void Mod::LoadReferenceObjects(ChecksumMap& checksums, ReferenceGraph* graph)
 {
+    if (graph != NULL && graph->GetChecksums(checksums)) {
+        return;
+    }
+
+    vector<GraphDependency> files;
     try {
-        ptr<File> f;
-        if ((f = Assets::LoadXML("GameObjectFiles.xml")) != NULL)
+        ptr<File> f = Assets::LoadXML("GameObjectFiles.xml");
+        files.push_back(GraphDependency(Assets::ASSET_XML, "GameObjectFiles.xml", f));
+        if (f != NULL)
         {
             XMLTree xml(*f);
             const XMLNode& root = xml.GetRoot();
             for (XMLNode::const_iterator p = root.begin(); p != root.end(); ++p)
             {
-                if (p->Equals("File") && p->GetData() != NULL && (f = Assets::LoadXML(Utils::Trim(p->GetData()))) != NULL) try
+                if (!p->Equals("File") || p->GetData() == NULL) {
+                    continue;
+                }
+                const string filename = Utils::Trim(p->GetData());
+                f = Assets::LoadXML(filename);
+                files.push_back(GraphDependency(Assets::ASSET_XML, filename, f));
+                if (f != NULL) try
                 {
                     XMLTree xml(*f);
                     const XMLNode& root = xml.GetRoot();
@@ -1529,49 +1946,43 @@ void Mod::LoadReferenceObjects(ChecksumMap& checksums)
         }
     } catch (ParseException&) {
     }
+
+    if (graph != NULL) {
+        graph->SetChecksums(checksums, files);
+    }
 }
 
 void Mod::Load()
 {
     Location root(""); // We need a "dummy" location for the root
 
-    ParseAnimationSFXMaps(root, "Data\\XML\\AnimationSFXMaps.txt");
-    ParseGameConstants(root, "GameConstants.xml");
-    ParseEnumeration(root, "Enum\\GameObjectCategoryType.xml",   "game object category",    m_categories);
-    ParseEnumeration(root, "Enum\\GameObjectPropertiesType.xml", "game object properties",  m_gameObjectProperties);
-    ParseEnumeration(root, "Enum\\SurfaceFXTriggerType.xml",     "surface FX trigger type", m_surfaceFXTriggerTypes);
-    ParseEnumeration(root, "Enum\\MovementClassType.xml",        "movement class type",     m_movementClasses);
-    ParseEnumeration(root, "Enum\\AIGoalCategoryType.xml",       "AI goal category type",   m_aiGoalCategoryTypes);
+    {
+        Stats::Timer timer("Constants and enumerations");
+        ParseAnimationSFXMaps(root, "Data\\XML\\AnimationSFXMaps.txt");
+        ParseGameConstants(root, "GameConstants.xml");
+        ParseEnumeration(root, "Enum\\GameObjectCategoryType.xml",   "game object category",    m_categories);
+        ParseEnumeration(root, "Enum\\GameObjectPropertiesType.xml", "game object properties",  m_gameObjectProperties);
+        ParseEnumeration(root, "Enum\\SurfaceFXTriggerType.xml",     "surface FX trigger type", m_surfaceFXTriggerTypes);
+        ParseEnumeration(root, "Enum\\MovementClassType.xml",        "movement class type",     m_movementClasses);
+        ParseEnumeration(root, "Enum\\AIGoalCategoryType.xml",       "AI goal category type",   m_aiGoalCategoryTypes);
+    }
     
     // Factions must occur before GameObjects !!!
     ParseIndexFile(root, "FactionFiles.xml",    "faction",     m_factions,    Tags_Faction, &Mod::ParseObject, &Mod::ParseFaction);
     ParseIndexFile(root, "GameObjectFiles.xml", "game object", m_gameObjects, Tags_GameObject, &Mod::ParseObject, &Mod::ParseGameObject);
 
     // Create checksum lookup for GameObjects
-    for (ObjectList::const_iterator p = m_gameObjects.begin(); p != m_gameObjects.end(); ++p)
-    {
-        m_checksums.insert(make_pair(Utils::CRC32(p->first.c_str(), p->first.length()), p->first));
-    }
+    m_checksums.build(m_gameObjects);
 
     // Enumerate and parse Maps
     // Must occurs after GameObjects (and checksums) !!!
-    ptr<Assets::IEnumerator> enumerator = Assets::Enumerate("Data\\Art\\Maps\\*.ted");
-    if (enumerator != NULL) do {
-        ptr<File> f = LoadAsset(Reference(ObjectID(OBJ_MAP, enumerator->GetFileName().substr(14)), Location("<root>")));
-        if (f != NULL) try
-        {
-            string      map_name = Utils::GetFilename(f->GetName());
-            Assets::Map map(*f, true);
-            if (map.GetProperties().m_numPlayers > 1) {
-                // It's a multiplayer map, add it to the global references
-                m_globals.add(Reference(ObjectID(OBJ_MAP, map_name), root));
-            }
-        }
-        catch (BadFileException&)
-        {
-            error(root, "Bad map file: " + f->GetName());
-        }
-    } while (enumerator->Next());
+    {
+        Stats::Timer timer("Maps");
+        ptr<Assets::IEnumerator> enumerator = Assets::Enumerate("Data\\Art\\Maps\\*.ted");
+        if (enumerator != NULL) do {
+            ParseMapHeader(root, enumerator->GetFileName().substr(14));
+        } while (enumerator->Next());
+    }
 
     ParseIndexFile(root, "TradeRouteFiles.xml",          "traderoute",             m_tradeRoutes,         Tags_TradeRoute);
 	ParseIndexFile(root, "HardPointDataFiles.xml",       "hard point",             m_hardpoints,          Tags_Hardpoint);
@@ -1600,39 +2011,59 @@ void Mod::Load()
     {
         ParseFile (root, "BlackMarketItems.xml",         "black market item",      m_blackMarketItems,    Tags_BlackMarketItem);
     }
-    ParseAudio    (root, "Audio.xml");
-    ParseRadarMap (root, "RadarMap.xml");
-    ParseWeatherAudio(root, "WeatherAudio.xml");
+    {
+        Stats::Timer timer("Audio");
+        ParseAudio    (root, "Audio.xml");
+        ParseRadarMap (root, "RadarMap.xml");
+        ParseWeatherAudio(root, "WeatherAudio.xml");
+    }
 
     // Enumerate and parse AI players
-    ptr<Assets::IEnumerator> enumator = Assets::Enumerate("Data\\XML\\AI\\Players\\*.xml");
-    if (enumator != NULL) do {
-        ParseAIPlayer(root, enumator->GetFileName().substr(9));
-    } while (enumator->Next());
+    ptr<Assets::IEnumerator> enumator;
+    {
+        Stats::Timer timer("AI players");
+        enumator = Assets::Enumerate("Data\\XML\\AI\\Players\\*.xml");
+        if (enumator != NULL) do {
+            ParseAIPlayer(root, enumator->GetFileName().substr(9));
+        } while (enumator->Next());
+    }
 
     // Enumerate and parse Goals
-    enumator = Assets::Enumerate("Data\\XML\\AI\\Goals\\*.xml");
-    if (enumator != NULL) do {
-        ParseFile(root, enumator->GetFileName().substr(9).c_str(), "goal", m_goals, Tags_Goal, &Mod::ParseGoal);
-    } while (enumator->Next());
+    {
+        Stats::Timer timer("AI goals");
+        enumator = Assets::Enumerate("Data\\XML\\AI\\Goals\\*.xml");
+        if (enumator != NULL) do {
+            ParseFile(root, enumator->GetFileName().substr(9).c_str(), "goal", m_goals, Tags_Goal, &Mod::ParseGoal);
+        } while (enumator->Next());
+    }
 
     // Enumerate and parse Templates
-    enumator = Assets::Enumerate("Data\\XML\\AI\\Templates\\*.xml");
-    if (enumator != NULL) do {
-        ParseFile(root, enumator->GetFileName().substr(9).c_str(), "AI template", m_aiTemplates, Tags_Template, &Mod::ParseTemplate);
-    } while (enumator->Next());
+    {
+        Stats::Timer timer("AI templates");
+        enumator = Assets::Enumerate("Data\\XML\\AI\\Templates\\*.xml");
+        if (enumator != NULL) do {
+            ParseFile(root, enumator->GetFileName().substr(9).c_str(), "AI template", m_aiTemplates, Tags_Template, &Mod::ParseTemplate);
+        } while (enumator->Next());
+    }
 
     // Enumerate and parse PerceptualEquations
-    enumator = Assets::Enumerate("Data\\XML\\AI\\PerceptualEquations\\*.xml");
-    if (enumator != NULL) do {
-        ParseFile(root, enumator->GetFileName().substr(9).c_str(), "perceptual equation", m_equations, Tags_Goal, &Mod::ParseEquation);
-    } while (enumator->Next());
+    {
+        Stats::Timer timer("AI perceptual equations");
+        enumator = Assets::Enumerate("Data\\XML\\AI\\PerceptualEquations\\*.xml");
+        if (enumator != NULL) do {
+            ParseFile(root, enumator->GetFileName().substr(9).c_str(), "perceptual equation", m_equations, Tags_Goal, &Mod::ParseEquation);
+        } while (enumator->Next());
+    }
 
     // Enumerate and parse AI scripts
-    enumator = Assets::Enumerate("Data\\Scripts\\AI\\*.lua");
-    if (enumator != NULL) do {
-        ParseAIScript(root, enumator->GetFileName().substr(13));
-    } while (enumator->Next());
+    {
+        Stats::Timer timer("AI scripts");
+        enumator = Assets::Enumerate("Data\\Scripts\\AI\\*.lua");
+        if (enumator != NULL) do {
+            ParseAIScript(root, enumator->GetFileName().substr(13));
+        } while (enumator->Next());
+        FlushScripts();
+    }
 
     // These essentials should be defined
     m_globals.add(Reference(ObjectID(OBJ_MUSIC_EVENT, "Main_Menu_Music_Event"), root));
@@ -1662,6 +2093,42 @@ void Mod::Load()
     }
 }
 
+string Mod::Suggest(const Reference& ref, const ObjectList* objects)
+{
+    map<ObjType, SuggestionIndex>::iterator p = m_suggestions.find(ref.id.type);
+    if (p == m_suggestions.end())
+    {
+        // First unknown reference of this type, build its index
+        p = m_suggestions.insert(make_pair(ref.id.type, SuggestionIndex())).first;
+        SuggestionIndex& index = p->second;
+        if (objects != NULL)
+        {
+            for (ObjectList::const_iterator q = objects->begin(); q != objects->end(); ++q)
+            {
+                index.add(q->second.m_name);
+            }
+        }
+        else if (ref.id.type == OBJ_STRING && !m_strings.empty())
+        {
+            vector<string> names;
+            m_strings[0]->GetNames(names);
+            for (size_t i = 0; i < names.size(); i++)
+            {
+                index.add(names[i]);
+            }
+        }
+        else if (ref.id.type == OBJ_TEXTURE)
+        {
+            ptr<Assets::IEnumerator> enumerator = Assets::Enumerate("Data\\Art\\Textures\\*");
+            if (enumerator != NULL) do {
+                index.add(enumerator->GetFileName().substr(18));
+            } while (enumerator->Next());
+        }
+        index.build();
+    }
+    return p->second.suggest(ref.id.name);
+}
+
 void Mod::Validate()
 {
     // Validate the references. We do this by keeping:
@@ -1673,6 +2140,8 @@ void Mod::Validate()
     // we also keep the list of already-validated object IDs.
     queue<const ReferenceList*> references;
     set<Reference>              checked;
+    vector<const Reference*>    audio;      // Audio references of this wave, see CheckAudio()
+    vector<vector<const Reference*> > missing(m_strings.size());    // Strings missing per language, see CheckString()
 
     // Initialize the list with the root references
     references.push(&m_globals);
@@ -1682,6 +2151,7 @@ void Mod::Validate()
     m_demand = &m_demands.back();
 
     // Commence validation
+    size_t wave_references = 0, wave_unchecked = 0;
     while (!references.empty())
     {
         const ReferenceList& refs = *references.front();
@@ -1690,8 +2160,11 @@ void Mod::Validate()
             Reference ref(*p);
             transform(ref.id.name.begin(), ref.id.name.end(), ref.id.name.begin(), toupper);
 
+            wave_references++;
             if (checked.insert(ref).second)
             {
+                wave_unchecked++;
+
                 // We haven't checked this one before
                 const BuiltinInfo* builtin     = NULL;
                 const ObjectList*  object_list = NULL;
@@ -1728,15 +2201,17 @@ void Mod::Validate()
                     case OBJ_OBJECT_PROPERTY:   success = CheckDefinition(*p, m_gameObjectProperties); break;
                     case OBJ_GOAL_CATEGORY_TYPE:success = CheckDefinition(*p, m_aiGoalCategoryTypes); break;
 
+                    // Audio references are checked at the end of the wave
+                    case OBJ_SFX:
+                    case OBJ_MUSIC:
+                    case OBJ_SPEECH:            audio.push_back(&*p); continue;
+
                     // Asset references
                     case OBJ_FILE:
                     case OBJ_TEXTURE:
-                    case OBJ_SFX:
-                    case OBJ_MUSIC:
-                    case OBJ_SPEECH:
                     case OBJ_SHADER:
                     case OBJ_ANIMATION:
-                    case OBJ_CINEMATIC:         success = (LoadAsset(*p, false) != NULL); break;
+                    case OBJ_CINEMATIC:         success = CheckAsset(*p); break;
                     case OBJ_MAP:               on_demand = &Mod::CheckMap; break;
                     case OBJ_MODEL_OR_PARTICLE: on_demand = &Mod::CheckModelOrParticle; break;
                     case OBJ_MODEL:             on_demand = &Mod::CheckModel; break;
@@ -1744,7 +2219,7 @@ void Mod::Validate()
                                                 on_demand = &Mod::CheckParticle; break;
                     case OBJ_SCRIPT:            on_demand = &Mod::CheckScript; break;
                     case OBJ_MTD_TEXTURE:       success = CheckMTD(*p, m_mtd); break;
-                    case OBJ_STRING:            success = CheckString(*p, m_strings); break;
+                    case OBJ_STRING:            success = CheckString(*p, m_strings, missing); break;
 
                     // Object references
                     case OBJ_GAME_OBJECT:       object_list = &m_gameObjects; break;
@@ -1783,20 +2258,14 @@ void Mod::Validate()
 
                     case OBJ_GAME_OBJECT_CRC:
                     {
-                        unsigned long crc;
-                        stringstream  ss;
-                        ss << p->id.name;
-                        ss >> crc;
-                        ChecksumMap::const_iterator c = m_checksums.find(crc);
-                        if (c != m_checksums.end()) {
-                            // The find will succeed
-                            references.push(&m_gameObjects.find(c->second)->second.m_references);
-                        } else {
-                            unknown_crc(p->location, crc, m_reference);
+                        const ModObject* obj = m_checksums.find(p->id.value);
+                        if (obj != NULL) {
+                            references.push(&obj->m_references);
+                            success = true;
                         }
-                        success = true;
+                        break;
                     }
- 
+
                     default:
                         assert(0);
                         break;
@@ -1820,20 +2289,40 @@ void Mod::Validate()
                     ptr<File> f = LoadAsset(*p, false);
                     if (f != NULL)
                     {
-                        (this->*on_demand)(*p, *f);
+                        if (on_demand == &Mod::CheckScript) {
+                            // Scripts are queued, their results are collected later
+                            (this->*on_demand)(*p, *f);
+                        } else {
+                            Unit unit(*this, string("Demand:") + GetObjTypeName(p->id.type), p->location, p->id.name, f);
+                            if (!unit.replayed) {
+                                (this->*on_demand)(*p, *f);
+                            }
+                        }
                         success = true;
                     }
                 }
 
-                if (!success) {
-                    unknown(p->location, GetObjTypeName(p->id.type), p->id.name);
+                if (!success && p->id.type == OBJ_GAME_OBJECT_CRC) {
+                    unknown_crc(p->location, p->id.value, m_reference);
+                } else if (!success) {
+                    unknown(p->location, GetObjTypeName(p->id.type), p->id.name, Suggest(*p, object_list));
                 }
+                Stats::AddCheck(p->id.type, success);
             }
         }
         references.pop();
 
         if (references.empty())
         {
+            CheckAudio(audio);
+            audio.clear();
+
+            // Report the scripts checked in this wave
+            FlushScripts();
+
+            Stats::AddWave(wave_references, wave_unchecked);
+            wave_references = wave_unchecked = 0;
+
             // We've depleted all references, now append the on-demand references so far and continue
             if (!m_demand->m_references.empty())
             {
@@ -1843,11 +2332,56 @@ void Mod::Validate()
             }
         }
     }
+
+    // Report any scripts still queued, so the report is complete when we return
+    FlushScripts();
+
+    // Report the strings that some languages lack
+    for (size_t i = 0; i < missing.size(); i++)
+    {
+        if (!missing[i].empty())
+        {
+            const string language = Utils::Uppercase(m_languages[i]);
+            cerr << "MasterTextFile_" << language << ".dat: " << missing[i].size() << " referenced strings are missing" << endl;
+            for (vector<const Reference*>::const_iterator p = missing[i].begin(); p != missing[i].end(); ++p)
+            {
+                error((*p)->location, "string \"" + (*p)->id.name + "\" is missing in " + language);
+            }
+        }
+    }
 }
 
-Mod::Mod(GameID game, const ChecksumMap& reference)
-    : m_demand(NULL), m_game(game), m_reference(reference)
+// Indexes a MasterTextFile on the thread pool
+struct IndexStringsJob : public Job
 {
+    const StringList* strings;
+    bool              failed;
+
+    void Run(size_t worker)
+    {
+        try
+        {
+            strings->Index();
+        }
+        catch (IOException&)
+        {
+            failed = true;
+        }
+    }
+
+    IndexStringsJob(const StringList* strings) : strings(strings), failed(false) {}
+};
+
+Mod::Mod(GameID game, const ChecksumMap& reference, size_t threads, ScriptMode scripts, ScriptCache* cache, ModelCache* models, bool languages, ReferenceGraph* graph)
+    : m_demand(NULL), m_game(game), m_reference(reference), m_threads(threads), m_models(models), m_graph(graph), m_unit(NULL)
+{
+    for (size_t i = 0; i < m_threads.size(); i++)
+    {
+        m_checkers.push_back(new ScriptChecker(scripts, cache));
+    }
+
+    InitializeTags();
+
 #ifndef NDEBUG
     // In debug mode, validate that the hardcoded arrays are sorted.
     ValidateTags();
@@ -1861,19 +2395,68 @@ Mod::Mod(GameID game, const ChecksumMap& reference)
         m_mtd.reset(new MegaTextureDirectory(f));
     }
 
-    f = NULL;
-    for (size_t i = 0; f == NULL && i < Builtins::Languages.count; i++)
+    for (size_t i = 0; (languages || m_strings.empty()) && i < Builtins::Languages.count; i++)
     {
         string filename = "MasterTextFile_" + Utils::Uppercase(Builtins::Languages.list[i].name) + ".dat";
         f = Assets::LoadFile("Data\\Text\\" + filename);
+        if (f != NULL) {
+            m_languages.push_back(Builtins::Languages.list[i].name);
+            m_strings.push_back(new StringList(f));
+        }
     }
     
-    if (f == NULL) {
+    if (m_strings.empty()) {
         cerr << "error: unable to load a MasterTextFile for any language" << endl;
-    } else {
-        m_strings.reset(new StringList(f));
+    }
+    else
+    {
+        // Index the files now, so a file that can't be read is reported and
+        // dropped here, rather than failing in the middle of the validation
+        vector<IndexStringsJob> jobs;
+        for (size_t i = 0; i < m_strings.size(); i++)
+        {
+            jobs.push_back(IndexStringsJob(m_strings[i]));
+        }
+        for (size_t i = 0; i < jobs.size(); i++)
+        {
+            m_threads.add(&jobs[i]);
+        }
+        m_threads.wait();
+
+        for (size_t i = jobs.size(); i > 0; i--)
+        {
+            if (jobs[i - 1].failed)
+            {
+                cerr << "error: unable to read \"MasterTextFile_" << Utils::Uppercase(m_languages[i - 1]) << ".dat\"" << endl;
+                m_strings  .erase(m_strings  .begin() + (i - 1));
+                m_languages.erase(m_languages.begin() + (i - 1));
+            }
+        }
     }
 
-    Load();
-    Validate();
-}
\ No newline at end of file
+    {
+        Stats::Timer timer("Load");
+        Load();
+    }
+
+    {
+        Stats::Timer timer("Validate");
+        Validate();
+    }
+
+    if (cache != NULL)
+    {
+        // Keep only the scripts used in this run
+        cache->clear();
+        for (size_t i = 0; i < m_checkers.size(); i++)
+        {
+            cache->merge(m_checkers[i]->GetCompiled());
+        }
+    }
+}
+
+// Defined here, where ScriptJob is complete. If the constructor throws, the
+// pool stops before the jobs still queued on it are released.
+Mod::~Mod()
+{
+}
@@ -4,36 +4,43 @@
 #include "Assets/Assets.h"
 #include "Tags.h"
 #include "builtins.h"
+#include "ModelCache.h"
+#include "Scripts.h"
+#include "General/NameSet.h"
+#include "General/Suggestions.h"
+#include "General/ThreadPool.h"
 #include <iostream>
 #include <list>
 #include <map>
 #include <set>
-extern "C"
-{
-#include "lua.h"
-#include "lauxlib.h"
-#include "lualib.h"
-}
+#include <vector>
+
+class ReferenceGraph;
 
 typedef std::string TextureName;
 typedef std::string FactionName;
 
 // An object ID is a unique identifier of any object
 // in the entire mod. It is a simple combination of type
-// and name.
+// and name. Types that are identified by a number rather
+// than a name (e.g., GameObject CRCs) use the value instead.
 // Do not confuse this with in-game objects. A texture is
 // also an object.
 struct ObjectID
 {
-    ObjType     type;
-    std::string name;
+    ObjType       type;
+    std::string   name;
+    unsigned long value;
 
     bool operator < (const ObjectID& rhs) const {
-        return (type < rhs.type) || (type == rhs.type && name < rhs.name);
+        return (type < rhs.type) || (type == rhs.type && (value < rhs.value || (value == rhs.value && name < rhs.name)));
     }
 
     ObjectID(ObjType type, const std::string& name)
-        : type(type), name(name) {}
+        : type(type), name(name), value(0) {}
+
+    ObjectID(ObjType type, unsigned long value)
+        : type(type), value(value) {}
 };
 
 // A reference is an object ID in a certain location.
@@ -55,8 +62,8 @@ struct ReferenceList
 {
     std::list<Reference> m_references;
 
-    void add(const Location& location, const char*        value, const char* pattern, const char* prefix = NULL);
-    void add(const Location& location, const std::string& value, const char* pattern, const char* prefix = NULL);
+    void add(const Location& location, const char*        value, const TagPattern& pattern, const char* prefix = NULL);
+    void add(const Location& location, const std::string& value, const TagPattern& pattern, const char* prefix = NULL);
     void add(const Reference& ref);
     bool add(const XMLNode& node, const Tags& tags);
     void add(const BuiltinInfo& builtin, ObjType type, const Location& location, GameID game);
@@ -72,13 +79,42 @@ struct ModObject
 };
 
 typedef std::map<std::string, ModObject> ObjectList;
-typedef std::set<std::string> DefinitionList;
+typedef NameSet DefinitionList;
 typedef std::map<unsigned long, std::string> ChecksumMap;
 
+// Open-addressed hash table from the CRC of a GameObject's
+// name to the GameObject itself. Maps can reference hundreds
+// of thousands of objects by CRC, so this is kept flat.
+class ChecksumIndex
+{
+    struct Slot
+    {
+        unsigned long    crc;
+        const ModObject* object;    // NULL for empty slots
+    };
+
+    std::vector<Slot> m_slots;      // Size is a power of two
+    size_t            m_mask;
+
+public:
+    // Builds the index for all objects in the list.
+    // On CRC collisions, the first object wins.
+    void build(const ObjectList& objects);
+
+    // Returns the object with this CRC, or NULL if there is none.
+    const ModObject* find(unsigned long crc) const;
+
+    ChecksumIndex() : m_mask(0) {}
+};
+
 class Mod
 {
     std::auto_ptr<MegaTextureDirectory> m_mtd;
-    std::auto_ptr<StringList> m_strings;
+
+    // The MasterTextFile of each language, in Builtins::Languages order.
+    // Unless all languages are checked, only the first one found is loaded.
+    std::vector<std::string> m_languages;
+    std::vector<ptr<StringList> > m_strings;
 
     GameID         m_game;
 
@@ -93,9 +129,35 @@ class Mod
     std::list<ReferenceList> m_demands;
     ReferenceList*           m_demand;
 
-    ChecksumMap        m_checksums; // Checksums of m_gameObjects
+    ChecksumIndex      m_checksums; // Checksums of m_gameObjects
     const ChecksumMap& m_reference; // Reference checksums of unmodded game objects
 
+    // Known names per type, for suggesting replacements for unknown references.
+    // Built on first use, once all objects have been loaded.
+    std::map<ObjType, SuggestionIndex> m_suggestions;
+
+    // Scripts are checked on the thread pool, with one checker per worker.
+    // Their results are reported in queued order by FlushScripts().
+    // The pool is declared after the checkers and jobs, so it stops before they are destroyed.
+    struct ScriptJob;
+    std::vector<ptr<ScriptChecker> > m_checkers;
+    std::vector<ptr<ScriptJob> >     m_scriptJobs;
+    ThreadPool                       m_threads;
+    std::set<std::string>            m_scriptFiles;  // Scripts whose references have been added, uppercased
+
+    ModelCache* m_models;   // Dependencies of models read in previous runs; may be NULL
+
+    // Files are parsed and checked as units of the reference graph; see ReferenceGraph.
+    // Only one unit records at a time. Keys that repeat are counted, to tell them apart.
+    struct Unit;
+    ReferenceGraph*            m_graph;     // May be NULL
+    Unit*                      m_unit;      // Unit being recorded, or NULL
+    std::map<std::string, int> m_keys;
+
+    // The lists that units add to, by their index in the graph
+    static ObjectList     Mod::* const ObjectLists[];
+    static DefinitionList Mod::* const DefinitionLists[];
+
     ReferenceList m_globals;
     ObjectList    m_gameObjects,
                   m_radarMapEvents,
@@ -136,8 +198,6 @@ class Mod
     typedef ModObject* (Mod::*FileCallback)(const XMLNode&, const char*, ObjectList&, const Tags&, const ObjectCallback& callback, bool allow_duplicates);
     typedef void       (Mod::*OnDemandCheck)(const Reference&, File& f);
 
-    static int Lua_Require(lua_State *L);
-
     // Object-level callbacks
     void ParseCampaign(const XMLNode&, ModObject&, const Tags&);
     void ParseSurfaceFX(const XMLNode&, ModObject&, const Tags&);
@@ -156,14 +216,16 @@ class Mod
     ModObject* ParseTemplate       (const XMLNode& node, const char* type, ObjectList& objects, const Tags& tags, const ObjectCallback& callback = &Mod::ParseReferences, bool allow_duplicates = false);
     ModObject* ParseEquation       (const XMLNode& node, const char* type, ObjectList& objects, const Tags& tags, const ObjectCallback& callback = &Mod::ParseReferences, bool allow_duplicates = false);
 
-    void ParseModel     (const Location& location, Assets::Model& f);
-    void ParseParticle  (const Location& location, Assets::ParticleSystem& f);
+    void ParseModel     (const Location& location, const ModelDependencies& deps);
+    void ParseParticle  (const Location& location, const ModelDependencies& deps);
+
+    ModelCache::Key GetModelKey(File& f) const;
+    bool ReadDependencies(File& f, const ModelCache::Key& key, ModelCache::Type type, ModelDependencies& deps);
 
     // On-demand callbacks
     void ParseGoalSet   (const Reference& reference, File& f);
     void ParseStory     (const Reference& reference, File& f);
     void ParseStoryPlots(const Reference& reference, File& f);
-    void CheckScript    (lua_State* s);
     void CheckScript    (const Reference& reference, File& f);
     void CheckModel     (const Reference& reference, File& f);
     void CheckParticle  (const Reference& reference, File& f);
@@ -177,6 +239,7 @@ class Mod
     void ParseMarkup(const Location& location, const std::string& filename, ModObject& object);
 
     void ParseMap(const Location& location, const Assets::Map& map);
+    void ParseMapHeader(const Location& location, const std::string& filename);
     void ParseAnimationSFXMaps(const Location& location, const char* filename);
     void ParseAIScript(const Location& location, const std::string& filename);
     void ParseGameConstants(const Location& location, const char* filename);
@@ -187,14 +250,33 @@ class Mod
     void ParseWeatherAudio(const Location& loc, const char* filename);
     void ParseEnumeration(const Location& location, const char* filename, const std::string& type, DefinitionList& definitions);
 
+    // Add, find and load as part of the unit being recorded
+    std::pair<ObjectList::iterator, bool> InsertObject(ObjectList& objects, const std::string& key, const ModObject& object);
+    bool      IsDeclared(const ObjectList& objects, const std::string& key);
+    bool      InsertDefinition(DefinitionList& definitions, const std::string& name);
+    ptr<File> LoadAsset(const Reference& ref, bool error = true);
+
+    std::string Suggest(const Reference& ref, const ObjectList* objects);
+
+    void QueueScript(const std::string& name, File& f, bool ai);
+    void FlushScripts();
+
     void Load();
     void Validate();
 public:
     // Assumes modpath is disabled and loads just the GameObjects to create a checksum reference
-    // This will be used to give suggestions when a CRC miss occurs.
-    static void LoadReferenceObjects(ChecksumMap& checksums);
+    // This will be used to give suggestions when a CRC miss occurs. If a graph is specified,
+    // the checksums are taken from it while the files they were read from are unchanged.
+    static void LoadReferenceObjects(ChecksumMap& checksums, ReferenceGraph* graph = NULL);
 
-    Mod(GameID game, const ChecksumMap& reference);
+    // If a script cache is specified, compiled scripts are taken from it. When
+    // the mod has been checked, it holds the scripts compiled in this run.
+    // If languages is set, strings are checked in the MasterTextFile of every
+    // language, and strings that only some languages lack are reported per language.
+    // If a graph is specified, files that haven't changed since the run it was loaded
+    // from are replayed from it instead of parsed. It receives the graph of this run.
+    Mod(GameID game, const ChecksumMap& reference, size_t threads = ThreadPool::GetNumProcessors(), ScriptMode scripts = SCRIPT_EXECUTE, ScriptCache* cache = NULL, ModelCache* models = NULL, bool languages = false, ReferenceGraph* graph = NULL);
+    ~Mod();
 };
 
 #endif
\ No newline at end of file
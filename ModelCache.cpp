@@ -0,0 +1,206 @@
+#include "ModelCache.h"
+#include "General/ExactTypes.h"
+#include "General/Exceptions.h"
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+using namespace std;
+
+// Identifies the cache file format. Bump the version when it changes.
+static const char     CACHE_MAGIC[4] = {'M','C','M','C'};
+static const uint32_t CACHE_VERSION  = 2;
+
+// The finalizer of MurmurHash3. Every bit of the input affects every bit of the result.
+static inline uint64_t Mix(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+ModelCache::Key ModelCache::GetKey(File& f)
+{
+    // Each 64-bit word is mixed into the hash with a full avalanche, so
+    // changes in different words don't cancel out, as they can with FNV-1a
+    // over words. The last partial word is padded with zeroes; the size
+    // is part of the key, so that's unambiguous.
+    Key key;
+    key.size = f.GetSize();
+    key.hash = 14695981039346656037ULL;
+
+    vector<uint64_t> buffer(8192);
+    f.SetPosition(0);
+    try
+    {
+        size_t size;
+        while ((size = f.Read(&buffer[0], buffer.size() * sizeof(uint64_t))) > 0)
+        {
+            const size_t words = size / sizeof(uint64_t);
+            for (size_t i = 0; i < words; i++)
+            {
+                key.hash = Mix(key.hash ^ buffer[i]);
+            }
+            if (size % sizeof(uint64_t) != 0)
+            {
+                uint64_t tail = 0;
+                memcpy(&tail, &buffer[words], size % sizeof(uint64_t));
+                key.hash = Mix(key.hash ^ tail);
+            }
+        }
+    }
+    catch (IOException&)
+    {
+        // Unreadable files fail to parse as well; the key doesn't matter
+    }
+    f.SetPosition(0);
+    return key;
+}
+
+const ModelDependencies* ModelCache::find(const Key& key, Type type)
+{
+    EntryMap::iterator p = m_entries.find(make_pair(key, type));
+    if (p == m_entries.end()) {
+        return NULL;
+    }
+    p->second.used = true;
+    return &p->second.dependencies;
+}
+
+void ModelCache::add(const Key& key, Type type, const ModelDependencies& dependencies)
+{
+    Entry& entry = m_entries[make_pair(key, type)];
+    entry.dependencies = dependencies;
+    entry.used         = true;
+}
+
+template <typename T>
+static bool Read(istream& is, T& value)
+{
+    return (bool)is.read((char*)&value, sizeof value);
+}
+
+template <typename T>
+static void Write(ostream& os, const T& value)
+{
+    os.write((const char*)&value, sizeof value);
+}
+
+// Reads a string with its length. The length is checked against the
+// rest of the file, so a damaged cache can't cause huge allocations.
+static bool Read(istream& is, string& str, streamoff remaining)
+{
+    uint32_t size;
+    if (!Read(is, size) || size > remaining) {
+        return false;
+    }
+    vector<char> data(size);
+    if (size > 0 && !is.read(&data[0], size)) {
+        return false;
+    }
+    str.assign(data.begin(), data.end());
+    return true;
+}
+
+static void Write(ostream& os, const string& str)
+{
+    Write(os, (uint32_t)str.size());
+    os.write(str.data(), str.size());
+}
+
+static bool Read(istream& is, set<string>& strings, streamoff remaining)
+{
+    uint32_t count;
+    if (!Read(is, count) || count > remaining) {
+        return false;
+    }
+    for (uint32_t i = 0; i < count; i++)
+    {
+        string str;
+        if (!Read(is, str, remaining)) {
+            return false;
+        }
+        strings.insert(str);
+    }
+    return true;
+}
+
+static void Write(ostream& os, const set<string>& strings)
+{
+    Write(os, (uint32_t)strings.size());
+    for (set<string>::const_iterator p = strings.begin(); p != strings.end(); ++p)
+    {
+        Write(os, *p);
+    }
+}
+
+void ModelCache::Load(const string& filename)
+{
+    m_entries.clear();
+
+    ifstream file(filename.c_str(), ios::binary);
+    file.seekg(0, ios::end);
+    const streamoff length = file.tellg();
+    file.seekg(0, ios::beg);
+
+    char     magic[4];
+    uint32_t version, count;
+    if (!file || !file.read(magic, 4) || memcmp(magic, CACHE_MAGIC, 4) != 0 || !Read(file, version) || version != CACHE_VERSION || !Read(file, count))
+    {
+        return;
+    }
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        Key      key;
+        uint32_t type;
+        uint8_t  valid;
+        Entry    entry;
+        ModelDependencies& deps = entry.dependencies;
+        if (!Read(file, key.size) || !Read(file, key.hash) || !Read(file, type) || type > PARTICLE || !Read(file, valid) ||
+            !Read(file, deps.name, length) || !Read(file, deps.shaders, length) || !Read(file, deps.textures, length) || !Read(file, deps.particles, length))
+        {
+            // Damaged; start over
+            m_entries.clear();
+            return;
+        }
+        deps.valid = (valid != 0);
+        entry.used = false;
+        m_entries[make_pair(key, (Type)type)] = entry;
+    }
+}
+
+void ModelCache::Save(const string& filename) const
+{
+    uint32_t count = 0;
+    for (EntryMap::const_iterator p = m_entries.begin(); p != m_entries.end(); ++p)
+    {
+        count += p->second.used ? 1 : 0;
+    }
+
+    ofstream file(filename.c_str(), ios::binary);
+    file.write(CACHE_MAGIC, 4);
+    Write(file, CACHE_VERSION);
+    Write(file, count);
+    for (EntryMap::const_iterator p = m_entries.begin(); p != m_entries.end(); ++p)
+    {
+        if (p->second.used)
+        {
+            const ModelDependencies& deps = p->second.dependencies;
+            Write(file, p->first.first.size);
+            Write(file, p->first.first.hash);
+            Write(file, (uint32_t)p->first.second);
+            Write(file, (uint8_t)(deps.valid ? 1 : 0));
+            Write(file, deps.name);
+            Write(file, deps.shaders);
+            Write(file, deps.textures);
+            Write(file, deps.particles);
+        }
+    }
+    if (!file) {
+        throw runtime_error("Unable to write model cache \"" + filename + "\"");
+    }
+}
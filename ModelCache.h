@@ -0,0 +1,74 @@
+#ifndef MODELCACHE_H
+#define MODELCACHE_H
+
+#include "Assets/Files.h"
+#include <map>
+#include <set>
+#include <string>
+
+// What a model or particle file refers to, as used by Mod::ParseModel() and
+// Mod::ParseParticle(). A file that couldn't be read as such is kept as well.
+struct ModelDependencies
+{
+    bool                  valid;        // False for a bad file
+    std::string           name;         // Internal name, for particle systems
+    std::set<std::string> shaders;
+    std::set<std::string> textures;
+    std::set<std::string> particles;
+
+    ModelDependencies() : valid(false) {}
+};
+
+//
+// Dependencies of model and particle files by size and hash of their
+// contents. The cache is saved between runs, so unchanged files cost
+// a hash and a lookup instead of walking all their chunks.
+//
+class ModelCache
+{
+public:
+    // How the file was read
+    enum Type
+    {
+        MODEL,
+        PARTICLE,
+    };
+
+    // Identifies the contents of a file
+    struct Key
+    {
+        unsigned long long size;
+        unsigned long long hash;
+
+        bool operator < (const Key& rhs) const {
+            return (size != rhs.size) ? size < rhs.size : hash < rhs.hash;
+        }
+    };
+
+    // Returns the key of the file's contents
+    static Key GetKey(File& f);
+
+    // Returns the dependencies of the file with the specified key, read as the
+    // specified type, or NULL if it's not in the cache.
+    const ModelDependencies* find(const Key& key, Type type);
+
+    void add(const Key& key, Type type, const ModelDependencies& dependencies);
+
+    // Loads the cache from a file. A missing or outdated file leaves the cache empty.
+    void Load(const std::string& filename);
+
+    // Saves the files found or added in this run
+    void Save(const std::string& filename) const;
+
+private:
+    struct Entry
+    {
+        ModelDependencies dependencies;
+        bool              used;         // Found or added in this run
+    };
+
+    typedef std::map<std::pair<Key, Type>, Entry> EntryMap;
+    EntryMap m_entries;
+};
+
+#endif
@@ -0,0 +1,462 @@
+#include "ReferenceGraph.h"
+#include "General/ExactTypes.h"
+#include <cstring>
+#include <fstream>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+using namespace std;
+
+// Identifies the graph file format. Bump the version when it changes.
+static const char     GRAPH_MAGIC[4] = {'M','C','R','G'};
+static const uint32_t GRAPH_VERSION  = 1;
+
+bool GraphDependency::IsCurrent(const File* file) const
+{
+    ptr<File> f;
+    if (file == NULL) {
+        file = f = Assets::Load(type, name);
+    }
+    return (file != NULL ? file->GetFingerprint() : 0) == fingerprint;
+}
+
+GraphDependency::GraphDependency(Assets::AssetType type, const string& name, const File* file)
+    : type(type), name(name), fingerprint(file != NULL ? file->GetFingerprint() : 0)
+{
+}
+
+const GraphUnit* ReferenceGraph::find(const string& key) const
+{
+    UnitMap::const_iterator p = m_previous.find(key);
+    return (p != m_previous.end()) ? &p->second : NULL;
+}
+
+void ReferenceGraph::add(const string& key, const GraphUnit& unit)
+{
+    m_units[key] = unit;
+}
+
+bool ReferenceGraph::GetChecksums(ChecksumMap& checksums) const
+{
+    if (m_checksumFiles.empty()) {
+        return false;
+    }
+
+    for (vector<GraphDependency>::const_iterator p = m_checksumFiles.begin(); p != m_checksumFiles.end(); ++p)
+    {
+        if (!p->IsCurrent()) {
+            return false;
+        }
+    }
+    checksums = m_checksums;
+    return true;
+}
+
+void ReferenceGraph::SetChecksums(const ChecksumMap& checksums, const vector<GraphDependency>& files)
+{
+    m_checksums     = checksums;
+    m_checksumFiles = files;
+}
+
+//
+// The graph is written with a table of all strings up front. Names and file
+// names occur many times over, so the data refers to them by their index.
+//
+class GraphWriter
+{
+    map<string, uint32_t> m_indices;
+    vector<const string*> m_strings;
+    ostringstream         m_data;
+
+public:
+    template <typename T>
+    void write(const T& value)
+    {
+        m_data.write((const char*)&value, sizeof value);
+    }
+
+    void write(const string& str)
+    {
+        pair<map<string, uint32_t>::iterator, bool> ins = m_indices.insert(make_pair(str, (uint32_t)m_strings.size()));
+        if (ins.second) {
+            m_strings.push_back(&ins.first->first);
+        }
+        write(ins.first->second);
+    }
+
+    void write(const Location& location)
+    {
+        write(location.filename);
+        write((int32_t)location.line);
+    }
+
+    void write(const ReferenceList& references)
+    {
+        write((uint32_t)references.m_references.size());
+        for (list<Reference>::const_iterator p = references.m_references.begin(); p != references.m_references.end(); ++p)
+        {
+            write((uint32_t)p->id.type);
+            write(p->id.name);
+            write((uint32_t)p->id.value);
+            write(p->location);
+        }
+    }
+
+    // Writes a string in place, for keys and reports. Those rarely repeat.
+    void writeText(const string& str)
+    {
+        write((uint32_t)str.length());
+        m_data.write(str.data(), str.length());
+    }
+
+    void write(const GraphUnit& unit);
+
+    // Writes the string table, followed by the data
+    void save(ostream& os) const;
+};
+
+void GraphWriter::write(const GraphUnit& unit)
+{
+    write((uint32_t)unit.dependencies.size());
+    for (vector<GraphDependency>::const_iterator p = unit.dependencies.begin(); p != unit.dependencies.end(); ++p)
+    {
+        write((uint32_t)p->type);
+        write(p->name);
+        write(p->fingerprint);
+    }
+
+    write((uint32_t)unit.lookups.size());
+    for (vector<GraphLookup>::const_iterator p = unit.lookups.begin(); p != unit.lookups.end(); ++p)
+    {
+        write((uint32_t)p->list);
+        write((uint8_t)((p->definition ? 1 : 0) | (p->insert ? 2 : 0) | (p->found ? 4 : 0)));
+        write(p->key);
+        write(p->location);
+    }
+
+    write((uint32_t)unit.objects.size());
+    for (vector<GraphObject>::const_iterator p = unit.objects.begin(); p != unit.objects.end(); ++p)
+    {
+        write((uint32_t)p->list);
+        write(p->key);
+        write(p->object.m_name);
+        write(p->object.m_location);
+        write(p->object.m_references);
+    }
+
+    write((uint32_t)unit.definitions.size());
+    for (vector<pair<int, string> >::const_iterator p = unit.definitions.begin(); p != unit.definitions.end(); ++p)
+    {
+        write((uint32_t)p->first);
+        write(p->second);
+    }
+
+    write(unit.globals);
+    write(unit.demands);
+    writeText(unit.report);
+}
+
+void GraphWriter::save(ostream& os) const
+{
+    const uint32_t count = (uint32_t)m_strings.size();
+    os.write((const char*)&count, sizeof count);
+    for (vector<const string*>::const_iterator p = m_strings.begin(); p != m_strings.end(); ++p)
+    {
+        const uint32_t length = (uint32_t)(*p)->length();
+        os.write((const char*)&length, sizeof length);
+        os.write((*p)->data(), length);
+    }
+
+    const string data = m_data.str();
+    os.write(data.data(), data.length());
+}
+
+//
+// Reads what GraphWriter wrote. Every count and index is checked against the
+// rest of the file or the string table, so a damaged graph is rejected
+// instead of causing huge allocations.
+//
+class GraphReader
+{
+    istream&       m_stream;
+    streamoff      m_length;
+    vector<string> m_strings;
+
+public:
+    template <typename T>
+    bool read(T& value)
+    {
+        return (bool)m_stream.read((char*)&value, sizeof value);
+    }
+
+    bool read(string& str)
+    {
+        uint32_t index;
+        if (!read(index) || index >= m_strings.size()) {
+            return false;
+        }
+        str = m_strings[index];
+        return true;
+    }
+
+    bool read(Location& location)
+    {
+        int32_t line;
+        if (!read(location.filename) || !read(line)) {
+            return false;
+        }
+        location.line = line;
+        return true;
+    }
+
+    bool readCount(uint32_t& count)
+    {
+        return read(count) && count <= m_length;
+    }
+
+    bool read(ReferenceList& references)
+    {
+        uint32_t count;
+        if (!readCount(count)) {
+            return false;
+        }
+        for (uint32_t i = 0; i < count; i++)
+        {
+            uint32_t type, value;
+            string   name;
+            Location location("");
+            if (!read(type) || !read(name) || !read(value) || !read(location)) {
+                return false;
+            }
+            ObjectID id((ObjType)type, name);
+            id.value = value;
+            references.add(Reference(id, location));
+        }
+        return true;
+    }
+
+    bool read(GraphUnit& unit);
+
+    // Reads a string written in place, or one in the string table
+    bool readText(string& str)
+    {
+        uint32_t length;
+        if (!readCount(length)) {
+            return false;
+        }
+        vector<char> data(length);
+        if (length > 0 && !m_stream.read(&data[0], length)) {
+            return false;
+        }
+        str.assign(data.begin(), data.end());
+        return true;
+    }
+
+    // Reads the string table
+    bool open()
+    {
+        uint32_t count;
+        if (!readCount(count)) {
+            return false;
+        }
+        m_strings.resize(count);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            if (!readText(m_strings[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    GraphReader(istream& stream, streamoff length) : m_stream(stream), m_length(length) {}
+};
+
+bool GraphReader::read(GraphUnit& unit)
+{
+    uint32_t count;
+    if (!readCount(count)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint32_t type;
+        GraphDependency dependency(Assets::ASSET_FILE, "", NULL);
+        if (!read(type) || type > Assets::ASSET_CINEMATIC || !read(dependency.name) || !read(dependency.fingerprint)) {
+            return false;
+        }
+        dependency.type = (Assets::AssetType)type;
+        unit.dependencies.push_back(dependency);
+    }
+
+    if (!readCount(count)) {
+        return false;
+    }
+    unit.lookups.resize(count);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        GraphLookup& lookup = unit.lookups[i];
+        uint32_t list;
+        uint8_t  flags;
+        if (!read(list) || !read(flags) || !read(lookup.key) || !read(lookup.location)) {
+            return false;
+        }
+        lookup.list       = (int)list;
+        lookup.definition = (flags & 1) != 0;
+        lookup.insert     = (flags & 2) != 0;
+        lookup.found      = (flags & 4) != 0;
+    }
+
+    if (!readCount(count)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint32_t  list;
+        string    key;
+        ModObject object(Location(""));
+        if (!read(list) || !read(key) || !read(object.m_name) || !read(object.m_location) || !read(object.m_references)) {
+            return false;
+        }
+        unit.objects.push_back(GraphObject((int)list, key, object));
+    }
+
+    if (!readCount(count)) {
+        return false;
+    }
+    unit.definitions.resize(count);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint32_t list;
+        if (!read(list) || !read(unit.definitions[i].second)) {
+            return false;
+        }
+        unit.definitions[i].first = (int)list;
+    }
+
+    return read(unit.globals) && read(unit.demands) && readText(unit.report);
+}
+
+void ReferenceGraph::Load(const string& filename)
+{
+    m_previous.clear();
+    m_checksums.clear();
+    m_checksumFiles.clear();
+
+    ifstream file(filename.c_str(), ios::binary);
+    file.seekg(0, ios::end);
+    const streamoff length = file.tellg();
+    file.seekg(0, ios::beg);
+
+    GraphReader reader(file, length);
+
+    char     magic[4];
+    uint32_t version, count;
+    string   options;
+    if (!file || !file.read(magic, 4) || memcmp(magic, GRAPH_MAGIC, 4) != 0 || !reader.read(version) || version != GRAPH_VERSION ||
+        !reader.readText(options) || options != m_options || !reader.open())
+    {
+        return;
+    }
+
+    bool damaged = !reader.readCount(count);
+    for (uint32_t i = 0; !damaged && i < count; i++)
+    {
+        uint32_t crc;
+        string   name;
+        damaged = !reader.read(crc) || !reader.read(name);
+        m_checksums.insert(make_pair((unsigned long)crc, name));
+    }
+
+    damaged = damaged || !reader.readCount(count);
+    for (uint32_t i = 0; !damaged && i < count; i++)
+    {
+        uint32_t type;
+        GraphDependency dependency(Assets::ASSET_FILE, "", NULL);
+        damaged = !reader.read(type) || type > Assets::ASSET_CINEMATIC || !reader.read(dependency.name) || !reader.read(dependency.fingerprint);
+        dependency.type = (Assets::AssetType)type;
+        m_checksumFiles.push_back(dependency);
+    }
+
+    damaged = damaged || !reader.readCount(count);
+    for (uint32_t i = 0; !damaged && i < count; i++)
+    {
+        string key;
+        damaged = !reader.readText(key) || !reader.read(m_previous[key]);
+    }
+
+    if (damaged)
+    {
+        // Start over
+        m_previous.clear();
+        m_checksums.clear();
+        m_checksumFiles.clear();
+    }
+}
+
+void ReferenceGraph::Save(const string& filename) const
+{
+    GraphWriter writer;
+    writer.write((uint32_t)m_checksums.size());
+    for (ChecksumMap::const_iterator p = m_checksums.begin(); p != m_checksums.end(); ++p)
+    {
+        writer.write((uint32_t)p->first);
+        writer.write(p->second);
+    }
+
+    writer.write((uint32_t)m_checksumFiles.size());
+    for (vector<GraphDependency>::const_iterator p = m_checksumFiles.begin(); p != m_checksumFiles.end(); ++p)
+    {
+        writer.write((uint32_t)p->type);
+        writer.write(p->name);
+        writer.write(p->fingerprint);
+    }
+
+    writer.write((uint32_t)m_units.size());
+    for (UnitMap::const_iterator p = m_units.begin(); p != m_units.end(); ++p)
+    {
+        writer.writeText(p->first);
+        writer.write(p->second);
+    }
+
+    ofstream file(filename.c_str(), ios::binary);
+    file.write(GRAPH_MAGIC, 4);
+    file.write((const char*)&GRAPH_VERSION, sizeof GRAPH_VERSION);
+    const uint32_t length = (uint32_t)m_options.length();
+    file.write((const char*)&length, sizeof length);
+    file.write(m_options.data(), length);
+    writer.save(file);
+    if (!file) {
+        throw runtime_error("Unable to write reference graph \"" + filename + "\"");
+    }
+}
+
+int StreamCapture::overflow(int c)
+{
+    if (c == EOF) {
+        return 0;
+    }
+    m_text += (char)c;
+    return m_original->sputc((char)c);
+}
+
+streamsize StreamCapture::xsputn(const char* s, streamsize n)
+{
+    m_text.append(s, (size_t)n);
+    return m_original->sputn(s, n);
+}
+
+int StreamCapture::sync()
+{
+    return m_original->pubsync();
+}
+
+StreamCapture::StreamCapture(ostream& stream)
+    : m_stream(stream), m_original(stream.rdbuf(this))
+{
+}
+
+StreamCapture::~StreamCapture()
+{
+    m_stream.rdbuf(m_original);
+}
@@ -0,0 +1,129 @@
+#ifndef REFERENCEGRAPH_H
+#define REFERENCEGRAPH_H
+
+#include "Mod.h"
+#include <map>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+// A file that a unit loaded, or looked for
+struct GraphDependency
+{
+    Assets::AssetType  type;
+    std::string        name;
+    unsigned long long fingerprint;     // See File::GetFingerprint(); 0 if it wasn't found
+
+    // Returns true if loading the file now finds the same file. If the caller
+    // already loaded it, it can pass it instead of loading it again.
+    bool IsCurrent(const File* file = NULL) const;
+
+    GraphDependency(Assets::AssetType type, const std::string& name, const File* file);
+};
+
+// A lookup of a name in an object or definition list. Whether a name is
+// found decides what parsing a file adds and reports, e.g. a duplicate.
+struct GraphLookup
+{
+    int         list;           // Index in Mod's table of object or definition lists
+    bool        definition;     // In a definition list, rather than an object list
+    bool        insert;         // The name was added if it wasn't found
+    std::string key;            // Uppercased, for object lists
+    bool        found;
+    Location    location;       // Of the object that was found
+
+    GraphLookup() : location("") {}
+};
+
+// An object that a unit declared, or added references to. For an object
+// declared by an earlier unit, only its name and the added references are kept.
+struct GraphObject
+{
+    int         list;
+    std::string key;
+    ModObject   object;
+
+    GraphObject(int list, const std::string& key, const ModObject& object)
+        : list(list), key(key), object(object) {}
+};
+
+//
+// What loading or checking one file did, so it can be repeated without reading
+// the file: what it reported, and the objects, definitions and references it
+// added. The unit holds as long as the files it read are the same, and the
+// names it looked up are found, or not, as they were.
+//
+struct GraphUnit
+{
+    std::vector<GraphDependency> dependencies;
+    std::vector<GraphLookup>     lookups;
+    std::vector<GraphObject>     objects;
+    std::vector<std::pair<int, std::string> > definitions;
+    ReferenceList                globals;       // Added to the root references
+    ReferenceList                demands;       // Added to the on-demand references
+    std::string                  report;
+};
+
+//
+// The reference graph of a run: every file that was parsed while loading the
+// mod, or checked when it was first referenced, as a unit. Units are kept
+// by a key that identifies the parse. A later run with the same options
+// replays the units whose files didn't change, and only parses the others.
+//
+class ReferenceGraph
+{
+    typedef std::map<std::string, GraphUnit> UnitMap;
+
+    std::string m_options;          // Options that affect the units
+    UnitMap     m_previous;         // Units of the previous run
+    UnitMap     m_units;            // Units of this run
+
+    // Checksums of the unmodded game objects; see Mod::LoadReferenceObjects()
+    ChecksumMap                  m_checksums;
+    std::vector<GraphDependency> m_checksumFiles;
+
+public:
+    // Returns the unit with the key from the previous run, or NULL
+    const GraphUnit* find(const std::string& key) const;
+
+    // Keeps a unit of this run
+    void add(const std::string& key, const GraphUnit& unit);
+
+    // Gets the checksums of the previous run, if the files they were read from didn't change
+    bool GetChecksums(ChecksumMap& checksums) const;
+    void SetChecksums(const ChecksumMap& checksums, const std::vector<GraphDependency>& files);
+
+    // Loads the graph of the previous run. A missing or outdated file,
+    // or one of a run with other options, leaves the graph empty.
+    void Load(const std::string& filename);
+
+    // Saves the units of this run
+    void Save(const std::string& filename) const;
+
+    ReferenceGraph(const std::string& options) : m_options(options) {}
+};
+
+//
+// Copies everything written to a stream into a string, while
+// still writing it to the stream. Used to capture what a unit reports.
+//
+class StreamCapture : public std::streambuf
+{
+    std::ostream&   m_stream;
+    std::streambuf* m_original;
+    std::string     m_text;
+
+    int             overflow(int c);
+    std::streamsize xsputn(const char* s, std::streamsize n);
+    int             sync();
+
+    StreamCapture(const StreamCapture&);
+    StreamCapture& operator=(const StreamCapture&);
+public:
+    const std::string& str() const { return m_text; }
+
+    StreamCapture(std::ostream& stream);
+    ~StreamCapture();
+};
+
+#endif
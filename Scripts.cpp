@@ -0,0 +1,871 @@
+#include "Scripts.h"
+#include "Tags.h"
+#include "Assets/Assets.h"
+#include "General/Exceptions.h"
+#include "General/ExactTypes.h"
+#include "General/Utils.h"
+#include <cassert>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+extern "C"
+{
+#include "lua-5.0.3/src/lopcodes.h"
+#include "lua-5.0.3/src/lstate.h"
+}
+using namespace std;
+
+struct LuaLoadInfo
+{
+    const vector<char>* chunk;
+    bool                done;
+};
+
+// Reads a source or bytecode chunk from memory
+static const char * LuaChunkReader(lua_State *s, void *data, size_t *size)
+{
+    LuaLoadInfo* lli = (LuaLoadInfo*)data;
+    if (lli->done || lli->chunk->empty())
+    {
+        *size = 0;
+        return NULL;
+    }
+    lli->done = true;
+    *size = lli->chunk->size();
+    return &(*lli->chunk)[0];
+}
+
+static int LuaBytecodeWriter(lua_State *s, const void* p, size_t size, void* data)
+{
+    vector<char>* bytecode = (vector<char>*)data;
+    bytecode->insert(bytecode->end(), (const char*)p, (const char*)p + size);
+    return 1;
+}
+
+// The context of a check, for require()
+struct ScriptChecker::Context
+{
+    ScriptChecker* checker;
+    string         basepath;
+    string         filename;
+    ScriptInfo*    script;     // Receives the required files; may be NULL
+    unsigned long  instructions; // Instructions run so far, see Lua_Budget()
+    set<pair<int, string> > references; // References recorded so far, by line and value
+};
+
+// The addresses of these are used as keys in the registry of pooled states
+static char LuaKey_Globals;   // Metatable for the global table
+static char LuaKey_Dummy;     // Metatable for dummy objects
+static char LuaKey_Functions; // Engine functions, see CreateFunctionTable()
+static char LuaKey_Require;   // The require() function
+static char LuaKey_Context;   // Context of the current use
+
+// A dummy function that will be called for every operation on
+// every object in a Lua script. This way we can execute Lua scripts
+// and extract specific meaningful data without having to implement
+// every single type and function from the game.
+static int Lua_Dummy(lua_State *L)
+{
+    // Whatever we request, we return an empty dummy table with the
+    // state's dummy metatable, whose metamethods all lead back here.
+    lua_newtable(L);
+    lua_pushlightuserdata(L, &LuaKey_Dummy);
+    lua_rawget(L, LUA_REGISTRYINDEX);
+    lua_setmetatable(L, -2);
+    return 1;
+}
+
+// Engine functions whose literal string argument names an object, so
+// that calls such as Find_Object_Type("X_Wing") are checked like XML tags.
+// Story events aren't listed; there are no definitions to check them against.
+struct EngineFunction
+{
+    const char* name;
+    const TagPattern* pattern;  // Tag pattern of the argument; see ReferenceList::add()
+};
+
+static const EngineFunction EngineFunctions[] = {
+    {"Add_Objective",              &Pattern_String},
+    {"Create_Cinematic_Transport", &Pattern_GameObject},
+    {"Find_All_Objects_Of_Type",   &Pattern_GameObject},
+    {"Find_First_Object",          &Pattern_GameObject},
+    {"Find_Hint",                  &Pattern_GameObject},
+    {"Find_Object_Type",           &Pattern_GameObject},
+    {"Game_Message",               &Pattern_String},
+    {"Play_Bink_Movie",            &Pattern_Movie},
+    {"Play_Lightning_Effect",      &Pattern_LightningEffect},
+    {"Play_Music",                 &Pattern_MusicEvent},
+    {"Play_SFX_Event",             &Pattern_SFXEvent},
+    {NULL}
+};
+
+// Returns the engine function with the specified name, or NULL
+static const EngineFunction* FindEngineFunction(const char* name)
+{
+    for (const EngineFunction* f = EngineFunctions; f->name != NULL; f++)
+    {
+        if (strcmp(f->name, name) == 0) {
+            return f;
+        }
+    }
+    return NULL;
+}
+
+// Creates the table that unknown globals and fields of dummy objects are
+// looked up in. It holds a closure per engine function that records its
+// argument; any other name gives a dummy object. The lookup is a regular
+// table access, so recognizing the engine functions costs nothing extra.
+static void CreateFunctionTable(lua_State* L, lua_CFunction reference)
+{
+    lua_pushlightuserdata(L, &LuaKey_Functions);
+    lua_newtable(L);
+    for (const EngineFunction* f = EngineFunctions; f->name != NULL; f++)
+    {
+        lua_pushstring(L, f->name);
+        lua_pushlightuserdata(L, (void*)f);
+        lua_pushcclosure(L, reference, 1);
+        lua_rawset(L, -3);
+    }
+
+    lua_newtable(L);
+    lua_pushstring(L, "__index");
+    lua_pushcfunction(L, Lua_Dummy);
+    lua_rawset(L, -3);
+    lua_setmetatable(L, -2);
+    lua_rawset(L, LUA_REGISTRYINDEX);
+}
+
+// Creates the metatable shared by all dummy objects in the state.
+// The function table must have been created.
+static void CreateDummyMetatable(lua_State* L)
+{
+    static const char* MetaMethods[] = {
+        "__add",
+        "__sub",
+        "__mul",
+        "__div",
+        "__pow",
+        "__unm",
+        "__concat",
+        "__eq",
+        "__lt",
+        "__le",
+        //"__index",    // Looked up in the function table instead
+        //"__newindex", // Not this one, we do want to be able to regularly set values
+        "__call",
+        NULL
+    };
+
+    lua_pushlightuserdata(L, &LuaKey_Dummy);
+    lua_newtable(L);
+    for (size_t i = 0; MetaMethods[i] != NULL; i++)
+    {
+        lua_pushstring(L, MetaMethods[i]);
+        lua_pushcfunction(L, Lua_Dummy);
+        lua_rawset(L, -3);
+    }
+    lua_pushstring(L, "__index");
+    lua_pushlightuserdata(L, &LuaKey_Functions);
+    lua_rawget(L, LUA_REGISTRYINDEX);
+    lua_rawset(L, -3);
+    lua_rawset(L, LUA_REGISTRYINDEX);
+}
+
+//
+// LuaStatePool
+//
+
+#ifdef _MSC_VER
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+// The heap of the Lua state in use on this thread. The Lua allocator
+// has no state argument, so it allocates from here (see lmem.c).
+static THREAD_LOCAL Region* t_heap = NULL;
+
+extern "C" void* LuaHeap_Realloc(void* block, size_t oldsize, size_t size)
+{
+    assert(t_heap != NULL);
+    return t_heap->reallocate(block, oldsize, size);
+}
+
+extern "C" void LuaHeap_Free(void* block, size_t oldsize)
+{
+    assert(t_heap != NULL);
+    t_heap->free(block, oldsize);
+}
+
+// States that have grown beyond this (in KB) are closed instead of reused
+static const int MAX_POOLED_STATE_SIZE = 4096;
+
+// Budget for running a script, so scripts that loop forever or keep
+// building tables are reported instead of hanging the check.
+// The instructions are counted every BUDGET_CHECK_INTERVAL instructions;
+// the memory is the limit of the state's heap, so allocations beyond it fail.
+static const unsigned long MAX_SCRIPT_INSTRUCTIONS = 1000000;
+static const int           MAX_SCRIPT_MEMORY       = 65536;     // In KB
+static const int           BUDGET_CHECK_INTERVAL   = 10000;
+
+lua_State* LuaStatePool::acquire(void* context)
+{
+    State state;
+    state.previous = t_heap;
+    if (m_states.empty())
+    {
+        t_heap = state.heap = new Region;
+        state.heap->limit((size_t)MAX_SCRIPT_MEMORY * 1024);
+        lua_State* L = state.L = lua_open();
+        CreateFunctionTable(L, m_reference);
+        CreateDummyMetatable(L);
+
+        // Every unknown global is an engine function or a dummy object
+        lua_pushlightuserdata(L, &LuaKey_Globals);
+        lua_newtable(L);
+        lua_pushstring(L, "__index");
+        lua_pushlightuserdata(L, &LuaKey_Functions);
+        lua_rawget(L, LUA_REGISTRYINDEX);
+        lua_rawset(L, -3);
+        lua_rawset(L, LUA_REGISTRYINDEX);
+
+        lua_pushlightuserdata(L, &LuaKey_Require);
+        lua_pushcfunction(L, m_require);
+        lua_rawset(L, LUA_REGISTRYINDEX);
+    }
+    else
+    {
+        state = m_states.back();
+        state.previous = t_heap;
+        t_heap = state.heap;
+        m_states.pop_back();
+    }
+    m_active.push_back(state);
+
+    lua_State* L = state.L;
+    lua_pushlightuserdata(L, &LuaKey_Context);
+    lua_pushlightuserdata(L, context);
+    lua_rawset(L, LUA_REGISTRYINDEX);
+
+    // Create a clean global table with require() and the shared metatable
+    lua_newtable(L);
+    lua_pushstring(L, "require");
+    lua_pushlightuserdata(L, &LuaKey_Require);
+    lua_rawget(L, LUA_REGISTRYINDEX);
+    lua_rawset(L, -3);
+    lua_pushlightuserdata(L, &LuaKey_Globals);
+    lua_rawget(L, LUA_REGISTRYINDEX);
+    lua_setmetatable(L, -2);
+    lua_replace(L, LUA_GLOBALSINDEX);
+    return L;
+}
+
+void LuaStatePool::release(lua_State* L)
+{
+    assert(!m_active.empty() && m_active.back().L == L);
+    const State state = m_active.back();
+    m_active.pop_back();
+
+    lua_settop(L, 0);
+    if (lua_getgccount(L) > MAX_POOLED_STATE_SIZE || state.heap->size() > (size_t)MAX_POOLED_STATE_SIZE * 1024)
+    {
+        Close(state);
+    }
+    else
+    {
+        m_states.push_back(state);
+    }
+    t_heap = state.previous;
+}
+
+// Closes the state by releasing its heap. The states hold no resources
+// besides memory, so there's no need for lua_close() to free every object.
+void LuaStatePool::Close(const State& state)
+{
+    delete state.heap;
+}
+
+void* LuaStatePool::GetContext(lua_State* L)
+{
+    lua_pushlightuserdata(L, &LuaKey_Context);
+    lua_rawget(L, LUA_REGISTRYINDEX);
+    void* context = lua_touserdata(L, -1);
+    lua_pop(L, 1);
+    return context;
+}
+
+LuaStatePool::~LuaStatePool()
+{
+    for (size_t i = 0; i < m_states.size(); i++)
+    {
+        Close(m_states[i]);
+    }
+}
+
+//
+// ScriptCache
+//
+
+// Identifies the cache file format. Bump the version when it changes.
+static const char     CACHE_MAGIC[4] = {'M','C','L','C'};
+static const uint32_t CACHE_VERSION  = 1;
+
+unsigned long long ScriptCache::Hash(const vector<char>& source)
+{
+    // 64-bit FNV-1a
+    unsigned long long hash = 14695981039346656037ULL;
+    for (vector<char>::const_iterator p = source.begin(); p != source.end(); ++p)
+    {
+        hash = (hash ^ (unsigned char)*p) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+const CompiledScript* ScriptCache::find(unsigned long long hash) const
+{
+    ScriptMap::const_iterator p = m_scripts.find(hash);
+    return (p != m_scripts.end()) ? &p->second : NULL;
+}
+
+void ScriptCache::add(unsigned long long hash, const CompiledScript& script)
+{
+    m_scripts[hash] = script;
+}
+
+void ScriptCache::merge(const ScriptCache& cache)
+{
+    m_scripts.insert(cache.m_scripts.begin(), cache.m_scripts.end());
+}
+
+template <typename T>
+static bool Read(istream& is, T& value)
+{
+    return (bool)is.read((char*)&value, sizeof value);
+}
+
+template <typename T>
+static void Write(ostream& os, const T& value)
+{
+    os.write((const char*)&value, sizeof value);
+}
+
+// Reads a block with its length and CRC. The length is checked against
+// the rest of the file, and the CRC against the data, so a damaged
+// cache never reaches the Lua loader.
+static bool Read(istream& is, vector<char>& data, streamoff remaining)
+{
+    uint32_t size, crc;
+    if (!Read(is, size) || !Read(is, crc) || size > remaining) {
+        return false;
+    }
+    data.resize(size);
+    if (size > 0 && !is.read(&data[0], size)) {
+        return false;
+    }
+    return Utils::CRC32(data.empty() ? NULL : &data[0], size) == crc;
+}
+
+static void Write(ostream& os, const char* data, size_t size)
+{
+    Write(os, (uint32_t)size);
+    Write(os, (uint32_t)Utils::CRC32(data, size));
+    os.write(data, size);
+}
+
+void ScriptCache::Load(const string& filename)
+{
+    m_scripts.clear();
+
+    ifstream file(filename.c_str(), ios::binary);
+    file.seekg(0, ios::end);
+    const streamoff length = file.tellg();
+    file.seekg(0, ios::beg);
+
+    char     magic[4];
+    uint32_t version, count;
+    if (!file || !file.read(magic, 4) || memcmp(magic, CACHE_MAGIC, 4) != 0 || !Read(file, version) || version != CACHE_VERSION || !Read(file, count))
+    {
+        return;
+    }
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        unsigned long long hash;
+        int32_t            line;
+        CompiledScript     script;
+        vector<char>       message;
+        if (!Read(file, hash) || !Read(file, line) || !Read(file, message, length) || !Read(file, script.bytecode, length))
+        {
+            // Damaged; start over
+            m_scripts.clear();
+            return;
+        }
+        script.line = line;
+        script.message.assign(message.begin(), message.end());
+        m_scripts[hash] = script;
+    }
+}
+
+void ScriptCache::Save(const string& filename) const
+{
+    ofstream file(filename.c_str(), ios::binary);
+    file.write(CACHE_MAGIC, 4);
+    Write(file, CACHE_VERSION);
+    Write(file, (uint32_t)m_scripts.size());
+    for (ScriptMap::const_iterator p = m_scripts.begin(); p != m_scripts.end(); ++p)
+    {
+        Write(file, p->first);
+        Write(file, (int32_t)p->second.line);
+        Write(file, p->second.message.data(), p->second.message.size());
+        Write(file, p->second.bytecode.empty() ? NULL : &p->second.bytecode[0], p->second.bytecode.size());
+    }
+    if (!file) {
+        throw runtime_error("Unable to write script cache \"" + filename + "\"");
+    }
+}
+
+//
+// ScriptChecker
+//
+
+void ScriptChecker::error(const Location& location, const string& message)
+{
+    m_diagnostics->push_back(Diagnostic(location, message));
+}
+
+// Splits a Lua error message into the line and the actual message.
+// Returns the message.
+static const char* ParseLuaError(const char* lua_error, int& line)
+{
+    line = -1;
+    const char* col = strchr(lua_error, ':');
+    if (col++ != NULL) {
+        sscanf(col, "%d", &line);
+        // Advance past the next ": " to get the actual error message
+        if ((col = strchr(col, ':'))++ != NULL) {
+            lua_error = isspace(*col) ? col + 1 : col;
+        }
+    }
+    return lua_error;
+}
+
+// Reports the Lua error message on top of the stack
+void ScriptChecker::LuaError(const string& filename, lua_State* L)
+{
+    // We take our own filename, and append Lua's error message
+    int line;
+    const char* message = ParseLuaError(lua_tostring(L, -1), line);
+    error(Location(filename, line), message);
+}
+
+void ScriptChecker::Require(const Context& context, const char* include, int line)
+{
+    ptr<File> f;
+    string name;
+    if ((f = Assets::LoadScript(name = (context.basepath + include))) == NULL) {
+        f = Assets::LoadScript(name = (string("Library\\") + include));
+    }
+
+    if (f == NULL) {
+        error(Location(context.filename, line), "unknown script library \"" + name + "\"");
+    } else {
+        vector<char> source;
+        ReadSource(*f, source);
+
+        Check(name, f->GetName(), source);
+        if (context.script != NULL)
+        {
+            const string key = Utils::Uppercase(f->GetName());
+            const ScriptInfo& library = m_scripts[key];
+            context.script->requires.insert(key);
+            context.script->requires.insert(library.requires.begin(), library.requires.end());
+        }
+    }
+}
+
+int ScriptChecker::Lua_Require(lua_State *L)
+{
+    if (lua_gettop(L) > 0 && lua_isstring(L, -1))
+    {
+        const Context* context = (const Context*)LuaStatePool::GetContext(L);
+        assert(context != NULL);
+        context->checker->Require(*context, lua_tostring(L, -1), -1);
+    }
+    return 0;
+}
+
+// Called for the engine functions; records the first string argument,
+// which follows the object for method calls. The result is a dummy object.
+int ScriptChecker::Lua_Reference(lua_State *L)
+{
+    const EngineFunction* function = (const EngineFunction*)lua_touserdata(L, lua_upvalueindex(1));
+    for (int i = 1; i <= lua_gettop(L); i++)
+    {
+        if (lua_type(L, i) == LUA_TSTRING)
+        {
+            Context* context = (Context*)LuaStatePool::GetContext(L);
+            assert(context != NULL);
+
+            lua_Debug ar;
+            int line = -1;
+            if (lua_getstack(L, 1, &ar) && lua_getinfo(L, "l", &ar)) {
+                line = ar.currentline;
+            }
+
+            // Calls in loops are recorded once
+            const char* value = lua_tostring(L, i);
+            if (context->references.insert(make_pair(line, string(value))).second) {
+                context->checker->m_references->push_back(ScriptReference(Location(context->filename, line), value, function->pattern));
+            }
+            break;
+        }
+    }
+    return Lua_Dummy(L);
+}
+
+// Returns the string constant, or NULL if it's not a string
+static const char* GetString(const Proto* p, int index)
+{
+    return ttisstring(&p->k[index]) ? svalue(&p->k[index]) : NULL;
+}
+
+// A call of a global function with a literal string as first argument, found in the bytecode
+struct StaticCall
+{
+    const char* function;
+    const char* argument;
+    int         line;
+};
+
+// Checks if the function loaded into R(a) at pc is called with the arguments
+// that follow it. The other arguments are evaluated in the registers above
+// R(a+1), so the sequence ends at the first instruction that uses R(a) or
+// R(a+1), which must be the call. Arguments that branch aren't followed.
+static bool IsCalled(const Proto* p, int pc, int a)
+{
+    for (pc += 2; pc < p->sizecode; pc++)
+    {
+        const Instruction i = p->code[pc];
+        const OpCode     op = GET_OPCODE(i);
+        if ((op == OP_CALL || op == OP_TAILCALL) && GETARG_A(i) == a) {
+            return true;
+        }
+        if (GETARG_A(i) <= a + 1 || op == OP_JMP || op == OP_RETURN) {
+            break;
+        }
+    }
+    return false;
+}
+
+// Finds the calls of global functions with a literal string as first argument,
+// e.g. require("PGCommands"), in the function and its nested functions.
+static void FindCalls(const Proto* p, vector<StaticCall>& calls)
+{
+    // The sequence is: R(A) := function; R(A+1) := "argument"; ...; R(A)(R(A+1), ...)
+    for (int pc = 0; pc + 1 < p->sizecode; pc++)
+    {
+        const Instruction* code = &p->code[pc];
+        if (GET_OPCODE(code[0]) == OP_GETGLOBAL
+            && GET_OPCODE(code[1]) == OP_LOADK && GETARG_A(code[1]) == GETARG_A(code[0]) + 1
+            && IsCalled(p, pc, GETARG_A(code[0])))
+        {
+            StaticCall call;
+            if ((call.function = GetString(p, GETARG_Bx(code[0]))) != NULL && (call.argument = GetString(p, GETARG_Bx(code[1]))) != NULL)
+            {
+                call.line = (p->lineinfo != NULL) ? p->lineinfo[pc] : -1;
+                calls.push_back(call);
+            }
+        }
+    }
+
+    for (int i = 0; i < p->sizep; i++)
+    {
+        FindCalls(p->p[i], calls);
+    }
+}
+
+// Finds the literal string last assigned to a global in the function
+// or its nested functions, e.g. Category = "Attack". Returns NULL if none.
+static const char* FindAssignment(const Proto* p, const char* global)
+{
+    const char* value = NULL;
+
+    // The sequence is: R(A) := "value"; global := R(A)
+    for (int pc = 0; pc + 1 < p->sizecode; pc++)
+    {
+        const Instruction* code = &p->code[pc];
+        const char* name;
+        if (GET_OPCODE(code[0]) == OP_LOADK
+            && GET_OPCODE(code[1]) == OP_SETGLOBAL && GETARG_A(code[1]) == GETARG_A(code[0])
+            && (name = GetString(p, GETARG_Bx(code[1]))) != NULL && strcmp(name, global) == 0)
+        {
+            const char* str = GetString(p, GETARG_Bx(code[0]));
+            if (str != NULL) {
+                value = str;
+            }
+        }
+    }
+
+    for (int i = 0; i < p->sizep; i++)
+    {
+        const char* str = FindAssignment(p->p[i], global);
+        if (str != NULL) {
+            value = str;
+        }
+    }
+    return value;
+}
+
+// Returns the function prototype of the compiled script on top of the stack
+static const Proto* GetProto(lua_State* L)
+{
+    const Closure* closure = (const Closure*)lua_topointer(L, -1);
+    assert(closure != NULL && !closure->c.isC);
+    return closure->l.p;
+}
+
+// Resolves the requires and records the engine function references
+// of the compiled script on top of the stack, without running it
+void ScriptChecker::CheckStatic(const Context& context, lua_State* L)
+{
+    vector<StaticCall> calls;
+    FindCalls(GetProto(L), calls);
+    for (vector<StaticCall>::const_iterator p = calls.begin(); p != calls.end(); ++p)
+    {
+        const EngineFunction* function;
+        if (strcmp(p->function, "require") == 0)
+        {
+            Require(context, p->argument, p->line);
+        }
+        else if ((function = FindEngineFunction(p->function)) != NULL)
+        {
+            m_references->push_back(ScriptReference(Location(context.filename, p->line), p->argument, function->pattern));
+        }
+    }
+}
+
+void ScriptChecker::Lua_Budget(lua_State* L, lua_Debug* ar)
+{
+    Context* context = (Context*)LuaStatePool::GetContext(L);
+    assert(context != NULL);
+
+    context->instructions += BUDGET_CHECK_INTERVAL;
+    if (context->instructions > MAX_SCRIPT_INSTRUCTIONS)
+    {
+        lua_pushfstring(L, "script exceeded %d instructions", (int)MAX_SCRIPT_INSTRUCTIONS);
+        lua_error(L);
+    }
+}
+
+// Calls the function on top of the stack within the budget of the check
+int ScriptChecker::Call(lua_State* L)
+{
+    lua_sethook(L, Lua_Budget, LUA_MASKCOUNT, BUDGET_CHECK_INTERVAL);
+    const int result = lua_pcall(L, 0, 0, 0);
+    lua_sethook(L, NULL, 0, 0);
+
+    if (result == LUA_ERRMEM)
+    {
+        // The heap refused to grow beyond the memory budget. Report that instead
+        // of "not enough memory", lifting the limit for the message.
+        lua_pop(L, 1);
+        t_heap->limit(~(size_t)0);
+        lua_pushfstring(L, "script exceeded %d KB of memory", MAX_SCRIPT_MEMORY);
+        t_heap->limit((size_t)MAX_SCRIPT_MEMORY * 1024);
+    }
+    return result;
+}
+
+// Loads a source or bytecode chunk onto the stack of the state.
+// On failure, the error is left on the stack.
+bool ScriptChecker::Load(lua_State* L, const string& filename, const vector<char>& chunk)
+{
+    LuaLoadInfo info = {&chunk, false};
+    return lua_load(L, LuaChunkReader, &info, Utils::GetFilename(filename).c_str()) == 0;
+}
+
+// Compiles the script onto the stack of the state. Returns false
+// and reports the error if the script couldn't be compiled.
+bool ScriptChecker::Compile(lua_State* L, const string& filename, const vector<char>& source)
+{
+    unsigned long long hash = 0;
+    if (m_cache != NULL)
+    {
+        // Use the script compiled by this or a previous run
+        hash = ScriptCache::Hash(source);
+        const CompiledScript* script = m_compiled.find(hash);
+        if (script == NULL && (script = m_cache->find(hash)) != NULL)
+        {
+            m_compiled.add(hash, *script);
+            script = m_compiled.find(hash);
+        }
+
+        if (script != NULL)
+        {
+            if (script->bytecode.empty())
+            {
+                error(Location(filename, script->line), script->message);
+                return false;
+            }
+
+            if (Load(L, filename, script->bytecode))
+            {
+                return true;
+            }
+
+            // Unusable bytecode; compile the source instead
+            lua_pop(L, 1);
+        }
+    }
+
+    if (!Load(L, filename, source))
+    {
+        // Get and print error
+        if (lua_isstring(L, -1))
+        {
+            // Find the line part of the error (ignore the filename part)
+            CompiledScript script;
+            script.message = ParseLuaError(lua_tostring(L, -1), script.line);
+            error(Location(filename, script.line), script.message);
+            if (m_cache != NULL)
+            {
+                m_compiled.add(hash, script);
+            }
+        }
+        else
+        {
+            error(Location(filename), "unknown Lua error");
+        }
+        return false;
+    }
+
+    if (m_cache != NULL)
+    {
+        CompiledScript script;
+        lua_dump(L, LuaBytecodeWriter, &script.bytecode);
+        m_compiled.add(hash, script);
+    }
+    return true;
+}
+
+void ScriptChecker::Check(const string& name, const string& filename, const vector<char>& source)
+{
+    const string key = Utils::Uppercase(filename);
+    map<string, ScriptInfo>::iterator p = m_scripts.find(key);
+    if (p != m_scripts.end())
+    {
+        // Already checked; report the same errors again. If it's still being checked,
+        // we're in a require cycle and the outer check reports its errors.
+        if (!p->second.checking)
+        {
+            m_diagnostics->insert(m_diagnostics->end(), p->second.diagnostics.begin(), p->second.diagnostics.end());
+        }
+        return;
+    }
+
+    ScriptInfo&  script = m_scripts[key];
+    const size_t start  = m_diagnostics->size();
+
+    Context    info = {this, Utils::GetBasePath(name), filename, &script, 0};
+    lua_State* L    = m_states.acquire(&info);
+    if (Compile(L, filename, source))
+    {
+        script.compiled = true;
+
+        if (m_mode == SCRIPT_PARSE)
+        {
+            CheckStatic(info, L);
+        }
+        // Execute top-level chunk to resolve requires.
+        else if (Call(L) != 0)
+        {
+            LuaError(filename, L);
+        }
+    }
+    m_states.release(L);
+
+    // Remember the errors of this script and its requires
+    script.diagnostics.assign(m_diagnostics->begin() + start, m_diagnostics->end());
+    script.checking = false;
+}
+
+void ScriptChecker::CheckScript(const string& name, const string& filename, const vector<char>& source, DiagnosticList& diagnostics, ScriptReferenceList& references)
+{
+    m_diagnostics = &diagnostics;
+    m_references  = &references;
+    Check(name, filename, source);
+    m_diagnostics = NULL;
+    m_references  = NULL;
+}
+
+string ScriptChecker::CheckAIScript(const string& name, const string& filename, const vector<char>& source, DiagnosticList& diagnostics, ScriptReferenceList& references)
+{
+    string category;
+
+    m_diagnostics = &diagnostics;
+    m_references  = &references;
+    Context    info = {this, Utils::GetBasePath(name), filename, NULL, 0};
+    lua_State* L    = m_states.acquire(&info);
+    if (Compile(L, filename, source))
+    {
+        if (m_mode == SCRIPT_PARSE)
+        {
+            // Take the Category from the bytecode of Definitions()
+            CheckStatic(info, L);
+            const char* str = FindAssignment(GetProto(L), "Category");
+            if (str != NULL)
+            {
+                category = str;
+            }
+        }
+        // Execute top-level chunk to resolve requires.
+        else if (Call(L) != 0)
+        {
+            LuaError(name, L);
+        }
+        else
+        {
+            // Execute the "Definitions" function to establish the Category
+            lua_pushstring(L, "Definitions");
+            lua_gettable(L, LUA_GLOBALSINDEX);
+            if (Call(L) != 0)
+            {
+                LuaError(name, L);
+            }
+            else
+            {
+                // Get the category
+                lua_pushstring(L, "Category");
+                lua_gettable(L, LUA_GLOBALSINDEX);
+                if (lua_isstring(L, -1))
+                {
+                    category = lua_tostring(L, -1);
+                }
+            }
+        }
+    }
+    m_states.release(L);
+    m_diagnostics = NULL;
+    m_references  = NULL;
+    return category;
+}
+
+void ScriptChecker::ReadSource(File& f, vector<char>& source)
+{
+    source.resize(f.GetSize());
+    size_t read = 0, size;
+    try {
+        while (read < source.size() && (size = f.Read(&source[read], source.size() - read)) > 0) {
+            read += size;
+        }
+    } catch (IOException&) {
+    }
+    source.resize(read);
+}
+
+ScriptChecker::ScriptChecker(ScriptMode mode, const ScriptCache* cache)
+    : m_mode(mode), m_cache(cache), m_states(&ScriptChecker::Lua_Require, &ScriptChecker::Lua_Reference), m_diagnostics(NULL), m_references(NULL)
+{
+}
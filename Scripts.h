@@ -0,0 +1,195 @@
+#ifndef SCRIPTS_H
+#define SCRIPTS_H
+
+#include "Assets/Files.h"
+#include "Assets/XML.h"
+#include "General/Region.h"
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+extern "C"
+{
+#include "lua.h"
+}
+
+// A reported error
+struct Diagnostic
+{
+    Location    location;
+    std::string message;
+
+    Diagnostic(const Location& location, const std::string& message)
+        : location(location), message(message) {}
+};
+
+typedef std::vector<Diagnostic> DiagnosticList;
+
+struct TagPattern;
+
+// A reference found in a script, from a call of a known engine
+// function with a literal argument, e.g. Find_Object_Type("X_Wing").
+struct ScriptReference
+{
+    Location    location;
+    std::string value;
+    const TagPattern* pattern;  // Tag pattern of the value; see ReferenceList::add()
+
+    ScriptReference(const Location& location, const std::string& value, const TagPattern* pattern)
+        : location(location), value(value), pattern(pattern) {}
+};
+
+typedef std::vector<ScriptReference> ScriptReferenceList;
+
+// The outcome of checking a script file, remembered for the
+// rest of the run so every require of the file can reuse it.
+struct ScriptInfo
+{
+    bool                    checking;       // Still being checked; breaks require cycles
+    bool                    compiled;       // Compiled without errors
+    DiagnosticList          diagnostics;    // Reported errors, including those of required files
+    std::set<std::string>   requires;       // Transitively required files, uppercased
+
+    ScriptInfo() : checking(true), compiled(false) {}
+};
+
+// A pool of Lua states for checking scripts. The global metatable,
+// require() and the engine functions are set up once per state. A state gets a clean
+// global table for every use, instead of creating and closing
+// an entire Lua heap for every script.
+//
+// Each state allocates from its own region, which becomes the current
+// Lua heap of the thread while the state is in use. Closing a state
+// releases its region, without freeing its objects one by one.
+class LuaStatePool
+{
+    struct State
+    {
+        lua_State* L;
+        Region*    heap;
+        Region*    previous;            // Heap in use before the state was acquired
+    };
+
+    std::vector<State>      m_states;   // Available states
+    std::vector<State>      m_active;   // States in use, innermost last
+    lua_CFunction           m_require;
+    lua_CFunction           m_reference;    // Records the argument of an engine function
+
+    static void Close(const State& state);
+
+    LuaStatePool(const LuaStatePool&);
+    LuaStatePool& operator=(const LuaStatePool&);
+public:
+    // Returns a state with a clean global table. The context
+    // can be retrieved with GetContext() while the state is in use.
+    lua_State* acquire(void* context);
+
+    // Returns a state to the pool. States are released in the
+    // reverse order of acquiring them.
+    void release(lua_State* L);
+
+    static void* GetContext(lua_State* L);
+
+    LuaStatePool(lua_CFunction require, lua_CFunction reference) : m_require(require), m_reference(reference) {}
+    ~LuaStatePool();
+};
+
+// A compiled script, or the error that prevented compiling it
+struct CompiledScript
+{
+    std::vector<char> bytecode;     // As written by lua_dump; empty if the script didn't compile
+    int               line;         // Line of the compile error
+    std::string       message;      // Compile error
+
+    CompiledScript() : line(-1) {}
+};
+
+//
+// Compiled scripts by hash of their source. The cache is saved between
+// runs, so unchanged scripts (such as the game's script library) skip
+// the Lua parser on later runs.
+//
+class ScriptCache
+{
+    typedef std::map<unsigned long long, CompiledScript> ScriptMap;
+    ScriptMap m_scripts;
+public:
+    // Returns the hash of a script's source
+    static unsigned long long Hash(const std::vector<char>& source);
+
+    // Returns the compiled script with the specified hash, or NULL
+    const CompiledScript* find(unsigned long long hash) const;
+
+    void add(unsigned long long hash, const CompiledScript& script);
+    void merge(const ScriptCache& cache);
+    void clear() { m_scripts.clear(); }
+
+    // Loads the cache from a file. A missing or outdated file leaves the cache empty.
+    void Load(const std::string& filename);
+    void Save(const std::string& filename) const;
+};
+
+// How scripts are checked
+enum ScriptMode
+{
+    SCRIPT_EXECUTE,     // Run the top-level chunk, and Definitions() for AI scripts
+    SCRIPT_PARSE,       // Only compile; find requires and the Category in the bytecode
+};
+
+//
+// Checks Lua scripts by compiling them and running their top-level chunk,
+// which resolves their requires. Calls of known engine functions with a
+// literal argument are recorded as references. In parse mode, nothing is
+// run; such calls are found in the compiled functions instead.
+// A checker is not thread-safe, but checkers are independent of each
+// other, so each thread can use its own.
+//
+class ScriptChecker : public Object
+{
+    ScriptMode                        m_mode;
+    const ScriptCache*                m_cache;          // Compiled scripts from previous runs; may be NULL
+    ScriptCache                       m_compiled;       // Scripts compiled or found in the cache by this checker
+    LuaStatePool                      m_states;
+    std::map<std::string, ScriptInfo> m_scripts;        // Checked scripts, by uppercased file name
+    DiagnosticList*                   m_diagnostics;    // Receives the errors of the current check
+    ScriptReferenceList*              m_references;     // Receives the references of the current check
+
+    static int  Lua_Require(lua_State* L);
+    static int  Lua_Reference(lua_State* L);
+    static void Lua_Budget(lua_State* L, lua_Debug* ar);
+    static int  Call(lua_State* L);
+
+    struct Context;
+
+    void error(const Location& location, const std::string& message);
+    void Require(const Context& context, const char* include, int line);
+    void CheckStatic(const Context& context, lua_State* L);
+    void LuaError(const std::string& filename, lua_State* L);
+    bool Load(lua_State* L, const std::string& filename, const std::vector<char>& source);
+    bool Compile(lua_State* L, const std::string& filename, const std::vector<char>& source);
+    void Check(const std::string& name, const std::string& filename, const std::vector<char>& source);
+
+    ScriptChecker(const ScriptChecker&);
+    ScriptChecker& operator=(const ScriptChecker&);
+public:
+    // Checks a script and the scripts it requires. The name is the script's
+    // name in Data\Scripts, filename is the name of the file it was read from.
+    // Errors and references are appended to the lists. The references of
+    // a script are only reported by the first check that runs it.
+    void CheckScript(const std::string& name, const std::string& filename, const std::vector<char>& source, DiagnosticList& diagnostics, ScriptReferenceList& references);
+
+    // Checks an AI script and runs its Definitions() function.
+    // Returns the value of its Category global, or an empty string.
+    std::string CheckAIScript(const std::string& name, const std::string& filename, const std::vector<char>& source, DiagnosticList& diagnostics, ScriptReferenceList& references);
+
+    // Reads the entire script file. Read errors leave the source truncated,
+    // like they did when scripts were read while compiling.
+    static void ReadSource(File& f, std::vector<char>& source);
+
+    // Returns the scripts compiled, or found in the cache, by this checker
+    const ScriptCache& GetCompiled() const { return m_compiled; }
+
+    ScriptChecker(ScriptMode mode = SCRIPT_EXECUTE, const ScriptCache* cache = NULL);
+};
+
+#endif
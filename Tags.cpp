@@ -91,33 +91,71 @@ const char* GetObjTypeName(ObjType type) {
 }
 
 bool IsObjOfType(const string& value, ObjType type) {
+    return IsObjOfType(value.c_str(), value.length(), type);
+}
+
+// Checks the value at [value, value + length). The value must be followed
+// by a character that can't continue a number, such as whitespace or '\0'.
+bool IsObjOfType(const char* value, size_t length, ObjType type) {
     switch (type)
     {
     case OBJ_FLOAT:
     {
         char *endptr;
-        strtod(value.c_str(), &endptr);
-        return (*endptr == '\0');
+        strtod(value, &endptr);
+        return (endptr == value + length);
     }
 
     case OBJ_INTEGER:
     {
         char* endptr;
-        strtol(value.c_str(), &endptr, 0);
-        return (*endptr == '\0');
+        strtol(value, &endptr, 0);
+        return (endptr == value + length);
     }
 
     case OBJ_BOOLEAN:
-        return _stricmp(value.c_str(), "yes")   == 0 ||
-               _stricmp(value.c_str(), "true")  == 0 ||
-               _stricmp(value.c_str(), "no")    == 0 ||
-               _stricmp(value.c_str(), "false") == 0;
+        return (length == 3 && _strnicmp(value, "yes",   3) == 0) ||
+               (length == 4 && _strnicmp(value, "true",  4) == 0) ||
+               (length == 2 && _strnicmp(value, "no",    2) == 0) ||
+               (length == 5 && _strnicmp(value, "false", 5) == 0);
     
     }
     // Everything else is a reference; we can't check that here.
     return true;
 }
 
+TagPattern::TagPattern(const char* pattern)
+{
+    single = (strlen(pattern) == 1);
+    loop   = string::npos;
+    for (const char* s = pattern; *s != '\0' && *s != ')'; s++)
+    {
+        if (*s == '(') {
+            assert(loop == string::npos);
+            loop = types.size();
+        } else {
+            types.push_back(*s);
+        }
+    }
+
+    if (strchr(pattern, ')') == NULL) {
+        // An unterminated loop doesn't repeat
+        loop = types.size();
+    }
+    assert(loop <= types.size());
+}
+
+const TagPattern Pattern_String         ("s");
+const TagPattern Pattern_Strings        ("(s)");
+const TagPattern Pattern_Texture        ("t");
+const TagPattern Pattern_GameObject     ("G");
+const TagPattern Pattern_WeatherScenario("K");
+const TagPattern Pattern_SFXEvent       ("X");
+const TagPattern Pattern_MusicEvent     ("U");
+const TagPattern Pattern_Movie          ("M");
+const TagPattern Pattern_LightningEffect("L");
+const TagPattern Pattern_Goals          ("(!)");
+
 //
 // We terminate each tag list with a special marker so:
 // * the array isn't possibly empty
@@ -125,9 +163,9 @@ bool IsObjOfType(const string& value, ObjType type) {
 //
 static const char* MAGIC_STRING = "__\x42Magic__";
 #define BEGIN_TAGS(name, num)                        \
-    extern const TagInfo List_##name[num+1];         \
+    extern TagInfo List_##name[num+1];               \
     const Tags Tags_##name = {List_##name, (num+1)}; \
-    static const TagInfo List_##name[num+1] = {
+    static TagInfo List_##name[num+1] = {
 #define END_TAGS {MAGIC_STRING} }
 
 BEGIN_TAGS(None, 0)
@@ -927,6 +965,55 @@ const TagInfo* Tags::find(const char* name) const
     return NULL;
 }
 
+static void InitializeTags(const Tags& tags)
+{
+    for (size_t i = 0; i < tags.count; i++)
+    {
+        if (tags.list[i].pattern != NULL) {
+            tags.list[i].compiled = TagPattern(tags.list[i].pattern);
+        }
+    }
+}
+
+void InitializeTags()
+{
+    InitializeTags(Tags_None);
+    InitializeTags(Tags_TerrainDecal);
+    InitializeTags(Tags_SurfaceFX);
+    InitializeTags(Tags_DynamicTrack);
+    InitializeTags(Tags_TacticalCamera);
+    InitializeTags(Tags_LensFlare);
+    InitializeTags(Tags_BlackMarketItem);
+    InitializeTags(Tags_WeatherScenario);
+    InitializeTags(Tags_WeatherModifier);
+    InitializeTags(Tags_MousePointer);
+    InitializeTags(Tags_Goal);
+    InitializeTags(Tags_Template);
+    InitializeTags(Tags_Difficulty);
+    InitializeTags(Tags_CommandbarComponent);
+    InitializeTags(Tags_TargetingPriority);
+    InitializeTags(Tags_Campaign);
+    InitializeTags(Tags_Audio);
+    InitializeTags(Tags_TradeRoute);
+    InitializeTags(Tags_TradeRouteLine);
+    InitializeTags(Tags_WeatherAudio);
+    InitializeTags(Tags_Hardpoint);
+    InitializeTags(Tags_GameConstants);
+    InitializeTags(Tags_SFXEvent);
+    InitializeTags(Tags_LightningEffect);
+    InitializeTags(Tags_Ability);
+    InitializeTags(Tags_HeroClash);
+    InitializeTags(Tags_TextCrawl);
+    InitializeTags(Tags_RadarMapEvent);
+    InitializeTags(Tags_RadarMapSettings);
+    InitializeTags(Tags_Movie);
+    InitializeTags(Tags_MusicEvent);
+    InitializeTags(Tags_SpeechEvent);
+    InitializeTags(Tags_ShadowBlob);
+    InitializeTags(Tags_Faction);
+    InitializeTags(Tags_GameObject);
+}
+
 #ifndef NDEBUG
 // In debug mode, have the validation functions
 static void ValidateTags(const Tags& tags)
@@ -2,6 +2,7 @@
 #define TAGS_H
 
 #include <string>
+#include <vector>
 
 #define WHITESPACE " \t\r\n\f\v"
 
@@ -89,18 +90,45 @@ enum
 };
 
 extern bool        IsObjOfType(const std::string& value, ObjType type);
+extern bool        IsObjOfType(const char* value, size_t length, ObjType type);
 extern const char* GetObjTypeName(ObjType type);
 
+// A tag's pattern, compiled into the sequence of types it expects.
+// A pattern is a string of ObjType codes, where the part between
+// parentheses repeats for as long as there are values, e.g. "(s)" or "F(G)".
+struct TagPattern
+{
+    std::vector<ObjType> types;     // Expected type of each value
+    size_t               loop;      // Index to continue at after the last type; types.size() if none
+    bool                 single;    // The entire value is one token
+
+    TagPattern() : loop(0), single(false) {}
+    explicit TagPattern(const char* pattern);
+};
+
+// Patterns of references that code adds, rather than a tag
+extern const TagPattern Pattern_String;             // "s"
+extern const TagPattern Pattern_Strings;            // "(s)"
+extern const TagPattern Pattern_Texture;            // "t"
+extern const TagPattern Pattern_GameObject;         // "G"
+extern const TagPattern Pattern_WeatherScenario;    // "K"
+extern const TagPattern Pattern_SFXEvent;           // "X"
+extern const TagPattern Pattern_MusicEvent;         // "U"
+extern const TagPattern Pattern_Movie;              // "M"
+extern const TagPattern Pattern_LightningEffect;    // "L"
+extern const TagPattern Pattern_Goals;              // "(!)"
+
 struct TagInfo
 {
     const char* name;
     const char* pattern;
     const char* prefix;     // Prefix the value with this to form the reference
+    TagPattern  compiled;   // The pattern, compiled by InitializeTags()
 };
 
 struct Tags
 {
-    const TagInfo* list;
+    TagInfo*       list;
     size_t         count;
 
     const TagInfo* find(const char* name) const;
@@ -142,6 +170,9 @@ extern const Tags Tags_Template;
 extern const Tags Tags_BlackMarketItem;
 extern const Tags Tags_LensFlare;
 
+// Compiles the patterns of all tag lists. Call once, before using the lists.
+extern void InitializeTags();
+
 #ifndef NDEBUG
 extern void ValidateTags();
 #endif
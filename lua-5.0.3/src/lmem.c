@@ -19,6 +19,15 @@
 
 
 
+/*
+** ModCheck allocates Lua heaps from regions (see Scripts.cpp)
+*/
+extern void *LuaHeap_Realloc (void *block, size_t oldsize, size_t size);
+extern void LuaHeap_Free (void *block, size_t oldsize);
+#define l_realloc(b,os,s)	LuaHeap_Realloc(b,os,s)
+#define l_free(b,os)	LuaHeap_Free(b,os)
+
+
 /*
 ** definition for realloc function. It must assure that l_realloc(NULL,
 ** 0, x) allocates a new block (ANSI C assures that). (`os' is the old
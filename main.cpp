@@ -1,8 +1,13 @@
 #include "Assets/Assets.h"
 #include "General/Exceptions.h"
+#include "General/Stats.h"
+#include "General/ThreadPool.h"
 #include "General/Utils.h"
 #include "Mod.h"
+#include "ReferenceGraph.h"
+#include <fstream>
 #include <iostream>
+#include <sstream>
 #include <windows.h>
 #include <shlwapi.h>
 using namespace std;
@@ -59,6 +64,23 @@ static wstring GetBaseDirForGame(GameID game)
     return L"";
 }
 
+// Returns what identifies this build of the program: the size and last write time of its executable
+static string GetBuildIdentity()
+{
+    wchar_t path[MAX_PATH];
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    const DWORD length = GetModuleFileNameW(NULL, path, MAX_PATH);
+    if (length == 0 || length == MAX_PATH || !GetFileAttributesExW(path, GetFileExInfoStandard, &data))
+    {
+        throw runtime_error("Unable to get the version of the program");
+    }
+
+    stringstream ss;
+    ss << data.nFileSizeHigh << ':' << data.nFileSizeLow << ':'
+       << data.ftLastWriteTime.dwHighDateTime << ':' << data.ftLastWriteTime.dwLowDateTime;
+    return ss.str();
+}
+
 int main(int argc, const char* argv[])
 {
 #ifndef NDEBUG
@@ -72,6 +94,12 @@ int main(int argc, const char* argv[])
 #endif
     {
         GameID game = GID_NONE;
+        string stats_file;
+        size_t threads = ThreadPool::GetNumProcessors();
+        ScriptMode scripts = SCRIPT_EXECUTE;
+        string cache_file;
+        bool languages = false;
+        bool incremental = false;
 
         // Parse arguments
         for (int i = 1; i < argc; i++)
@@ -84,6 +112,32 @@ int main(int argc, const char* argv[])
                 else if (_stricmp(argv[i] + 1, "FOC") == 0) {
                     game = GID_EAW_FOC;
                 }
+                else if (_strnicmp(argv[i] + 1, "STATS", 5) == 0 && (argv[i][6] == '\0' || argv[i][6] == ':')) {
+                    // Write statistics to stdout, or the specified file
+                    Stats::Enable();
+                    stats_file = (argv[i][6] == ':') ? argv[i] + 7 : "";
+                }
+                else if (_strnicmp(argv[i] + 1, "CACHE", 5) == 0 && (argv[i][6] == '\0' || argv[i][6] == ':')) {
+                    // Keep compiled scripts and model dependencies in the specified file, or the default one
+                    cache_file = (argv[i][6] == ':') ? argv[i] + 7 : "ModCheck.cache";
+                }
+                else if (_stricmp(argv[i] + 1, "STATIC") == 0) {
+                    // Only parse scripts, don't run them
+                    scripts = SCRIPT_PARSE;
+                }
+                else if (_stricmp(argv[i] + 1, "LANGUAGES") == 0) {
+                    // Check strings in the text files of all languages
+                    languages = true;
+                }
+                else if (_stricmp(argv[i] + 1, "INCREMENTAL") == 0) {
+                    // Only parse the files that changed since the previous run, see ReferenceGraph
+                    incremental = true;
+                }
+                else if (_strnicmp(argv[i] + 1, "THREADS:", 8) == 0) {
+                    // Number of threads for checking scripts
+                    const int count = atoi(argv[i] + 9);
+                    threads = (count > 0) ? count : 1;
+                }
             }
         }
 
@@ -108,23 +162,78 @@ int main(int argc, const char* argv[])
             }
         }
 
+        if (incremental && cache_file.empty()) {
+            cache_file = "ModCheck.cache";
+        }
+
         wstring old_path, main_path = GetBaseDirForGame(GID_EAW);
         if (game == GID_EAW_FOC) {
             old_path  = main_path;
             main_path = GetBaseDirForGame(GID_EAW_FOC);
         }
 
+        // Everything besides the files that the reference graph depends on.
+        // Another build of the program may parse or report differently.
+        stringstream options;
+        if (incremental) {
+            options << GetBuildIdentity() << ' ';
+        }
+        options << game << ' ' << scripts << ' ' << languages << ' '
+                << Utils::ConvertWideStringToAnsiString(main_path) << ' ' << Utils::ConvertWideStringToAnsiString(old_path);
+
+        ReferenceGraph graph(options.str());
+        if (incremental) {
+            graph.Load(cache_file + ".graph");
+        }
+
         ChecksumMap reference;
 
         // Load the reference objects without mod path
-        Assets::Initialize(wstring(), main_path, old_path);
-        Mod::LoadReferenceObjects(reference);
+        {
+            Stats::Timer timer("Reference objects");
+            Assets::Initialize(wstring(), main_path, old_path);
+            Mod::LoadReferenceObjects(reference, incremental ? &graph : NULL);
+        }
 
         // Now do everything, with mod path
-        Assets::Initialize(L".", main_path, old_path);
-        Mod mod(game, reference);
+        {
+            Stats::Timer timer("Initialize assets");
+            Assets::Initialize(L".", main_path, old_path);
+        }
+        ScriptCache cache;
+        ModelCache  models;
+        if (!cache_file.empty()) {
+            cache.Load(cache_file);
+            models.Load(cache_file + ".models");
+        }
+
+        {
+            Mod mod(game, reference, threads, scripts, cache_file.empty() ? NULL : &cache, cache_file.empty() ? NULL : &models, languages, incremental ? &graph : NULL);
+        }
+
+        if (!cache_file.empty()) {
+            cache.Save(cache_file);
+            models.Save(cache_file + ".models");
+        }
+
+        if (incremental) {
+            graph.Save(cache_file + ".graph");
+        }
 
         Assets::Uninitialize();
+
+        if (Stats::IsEnabled())
+        {
+            if (stats_file.empty()) {
+                Stats::Write(cout, GetObjTypeName);
+            } else {
+                ofstream file(stats_file.c_str());
+                if (!file) {
+                    throw runtime_error("Unable to open \"" + stats_file + "\" for writing.");
+                }
+                Stats::Write(file, GetObjTypeName);
+            }
+        }
     }
 #ifdef NDEBUG
     catch (exception& e)